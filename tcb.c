@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #define MINIAUDIO_IMPLEMENTATION
 #include "miniaudio.h"
 #include "whisper.h"
@@ -13,28 +14,64 @@
 #include <sndfile.h>
 #include <unistd.h>
 #include <assert.h>
-
-ma_result tcb_device_init(ma_device_id *deviceId, tcb_device *device)
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <sched.h>
+#include <sys/resource.h>
+
+#ifdef GGML_USE_CUDA
+#include "ggml-cuda.h"
+#endif
+
+ma_result tcb_device_init(const tcb_context_config *contextConfig, ma_device_id *deviceId, const ma_allocation_callbacks *pAllocationCallbacks, tcb_device *device)
 {
     ma_device_config config = ma_device_config_init(ma_device_type_capture);
     config.capture.pDeviceID = deviceId;
     config.dataCallback = rb_write_callback;
+    config.performanceProfile = contextConfig->performanceProfile;
+    config.periodSizeInMilliseconds = contextConfig->periodMs;
+    config.periods = contextConfig->periods;
 
-    ma_result result = ma_device_init(NULL, &config, &device->device);
+    ma_result result = ma_device_init(contextConfig->pContext, &config, &device->device);
     if (result != MA_SUCCESS)
     {
         fprintf(stderr, "Failed to initialize capture device.\n");
         return result;
     }
 
-    result = ma_pcm_rb_init(device->device.capture.format, device->device.capture.channels, BUFFER_SIZE_IN_FRAMES, NULL, NULL, &device->rb);
+    /*
+     * The ring is sized in time at the device's native rate and format. It
+     * always holds a wake-up's worth of audio plus two periods, so the
+     * mixer is never woken to a ring that already overflowed.
+     */
+    ma_uint32 sampleRate = device->device.sampleRate;
+    device->wakeThresholdFrames = ma_max(1, (ma_uint32)((ma_uint64)contextConfig->wakeThresholdMs * sampleRate / 1000));
+    device->ringFrames = (ma_uint32)((ma_uint64)contextConfig->ringMs * sampleRate / 1000);
+    device->ringFrames = ma_max(device->ringFrames, 2 * (device->wakeThresholdFrames + device->device.capture.internalPeriodSizeInFrames));
+
+    result = ma_pcm_rb_init(device->device.capture.format, device->device.capture.channels, device->ringFrames, NULL, pAllocationCallbacks, &device->rb);
     if (result != MA_SUCCESS)
     {
         fprintf(stderr, "Failed to initialize ring buffer.\n");
+        ma_device_uninit(&device->device);
         return result;
     }
 
-    device->device.pUserData = &device->rb;
+    device->device.pUserData = device;
+    device->pAllocationCallbacks = pAllocationCallbacks;
+    device->wakeFd = -1;
+    device->pendingFrames = 0;
+    device->lastCallbackNs = 0;
+    atomic_init(&device->wakeTimeNs, 0);
+    memset(&device->stats, 0, sizeof(device->stats));
+    device->nominalRatio = (double)device->device.sampleRate / TARGET_SAMPLE_RATE;
+    device->rateRatio = device->nominalRatio;
+    device->driftError = 0;
+    device->driftIntegral = 0;
+    device->driftLastNs = 0;
 
     ma_data_converter_config converterConfig = ma_data_converter_config_init(
         device->device.capture.format,
@@ -43,8 +80,9 @@ ma_result tcb_device_init(ma_device_id *deviceId, tcb_device *device)
         TARGET_CHANNELS,
         device->device.sampleRate,
         TARGET_SAMPLE_RATE);
+    converterConfig.allowDynamicSampleRate = MA_TRUE;
 
-    result = ma_data_converter_init(&converterConfig, NULL, &device->converter);
+    result = ma_data_converter_init(&converterConfig, pAllocationCallbacks, &device->converter);
     if (result != MA_SUCCESS)
     {
         fprintf(stderr, "Failed to initialize data converter.\n");
@@ -60,7 +98,6 @@ ma_result tcb_device_start(tcb_device *device)
     if (result != MA_SUCCESS)
     {
         fprintf(stderr, "Failed to start device.\n");
-        ma_device_uninit(&device->device);
         return result;
     }
 
@@ -71,288 +108,2526 @@ void tcb_device_uninit(tcb_device *device)
 {
     ma_device_uninit(&device->device);
     ma_pcm_rb_uninit(&device->rb);
-    ma_data_converter_uninit(&device->converter, NULL);
+    ma_data_converter_uninit(&device->converter, device->pAllocationCallbacks);
+}
+
+ma_uint64 tcb_device_read_converted(tcb_device *device, ma_float *pFramesOut, ma_uint64 frameCount)
+{
+    ma_uint64 framesRead = 0;
+    while (framesRead < frameCount)
+    {
+        /* The ring hands out at most one contiguous region, so wrap-around takes two passes. */
+        ma_uint32 framesAvailable = ma_pcm_rb_available_read(&device->rb);
+        if (framesAvailable == 0)
+        {
+            break;
+        }
+
+        void *rbRead;
+        if (ma_pcm_rb_acquire_read(&device->rb, &framesAvailable, &rbRead) != MA_SUCCESS)
+        {
+            break;
+        }
+
+        ma_uint64 frameCountIn = framesAvailable;
+        ma_uint64 frameCountOut = frameCount - framesRead;
+        if (ma_data_converter_process_pcm_frames(&device->converter, rbRead, &frameCountIn, pFramesOut + framesRead, &frameCountOut) != MA_SUCCESS)
+        {
+            /* Runs on the mixer thread, the failure is flagged and printed off it. */
+            atomic_fetch_or_explicit(&device->stats.errors, TCB_ERROR_CONVERT, memory_order_relaxed);
+            ma_pcm_rb_commit_read(&device->rb, framesAvailable);
+            break;
+        }
+
+        ma_pcm_rb_commit_read(&device->rb, (ma_uint32)frameCountIn);
+        framesRead += frameCountOut;
+        if (frameCountIn == 0 && frameCountOut == 0)
+        {
+            break;
+        }
+    }
+
+    return framesRead;
+}
+
+ma_result tcb_arena_init(tcb_arena *arena, size_t capacity)
+{
+    arena->capacity = (capacity + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+    arena->offset = 0;
+    arena->heapCalls = 0;
+    arena->base = aligned_alloc(ARENA_ALIGNMENT, arena->capacity);
+    if (arena->base == NULL)
+    {
+        return MA_OUT_OF_MEMORY;
+    }
+    arena->heapCalls++;
+
+    return MA_SUCCESS;
+}
+
+void *tcb_arena_alloc(tcb_arena *arena, size_t size)
+{
+    size_t offset = (arena->offset + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+    if (offset + size > arena->capacity)
+    {
+        return NULL;
+    }
+
+    arena->offset = offset + size;
+    return arena->base + offset;
+}
+
+static void *tcb_counting_malloc(size_t size, void *pUserData)
+{
+    atomic_fetch_add_explicit((_Atomic ma_uint64 *)pUserData, 1, memory_order_relaxed);
+    return malloc(size);
+}
+
+static void *tcb_counting_realloc(void *p, size_t size, void *pUserData)
+{
+    atomic_fetch_add_explicit((_Atomic ma_uint64 *)pUserData, 1, memory_order_relaxed);
+    return realloc(p, size);
+}
+
+static void tcb_counting_free(void *p, void *pUserData)
+{
+    atomic_fetch_add_explicit((_Atomic ma_uint64 *)pUserData, 1, memory_order_relaxed);
+    free(p);
+}
+
+void tcb_arena_reset(tcb_arena *arena)
+{
+    arena->offset = 0;
+}
+
+void tcb_arena_uninit(tcb_arena *arena)
+{
+    free(arena->base);
+    arena->base = NULL;
+    arena->capacity = 0;
+    arena->offset = 0;
 }
 
-ma_result tcb_context_init(tcb_context *context, const char *pFilePath, ma_device_id *primaryDeviceId, ma_device_id *secundaryDeviceId)
+tcb_context_config tcb_context_config_init(void)
+{
+    tcb_context_config config;
+    config.pContext = NULL;
+    config.pGains = NULL;
+    config.gainCount = 0;
+    config.statsIntervalMs = 0;
+    config.driftCorrection = true;
+    config.format = TCB_FORMAT_WAV;
+    config.trackMode = TCB_TRACKS_NONE;
+    config.segmentMs = 0;
+    config.onFileClosed = NULL;
+    config.pUserData = NULL;
+    config.mixerPriority = 0;
+    config.mixerCpu = -1;
+    tcb_context_config_set_profile(&config, TCB_PROFILE_DEFAULT);
+
+    return config;
+}
+
+/*
+ * low-latency keeps blocks small for live transcription, throughput batches
+ * a second per wake-up for long unattended recordings. Options given after
+ * a profile override single values.
+ */
+void tcb_context_config_set_profile(tcb_context_config *config, tcb_latency_profile profile)
+{
+    switch (profile)
+    {
+    case TCB_PROFILE_LOW_LATENCY:
+        config->performanceProfile = ma_performance_profile_low_latency;
+        config->periodMs = 5;
+        config->periods = 2;
+        config->ringMs = 100;
+        config->mixBlockMs = 10;
+        config->wakeThresholdMs = 10;
+        config->wakeTimeoutMs = 100;
+        break;
+    case TCB_PROFILE_THROUGHPUT:
+        config->performanceProfile = ma_performance_profile_conservative;
+        config->periodMs = 100;
+        config->periods = 3;
+        config->ringMs = 3000;
+        config->mixBlockMs = 1000;
+        config->wakeThresholdMs = 1000;
+        config->wakeTimeoutMs = 2000;
+        break;
+    case TCB_PROFILE_DEFAULT:
+        config->performanceProfile = ma_performance_profile_low_latency;
+        config->periodMs = 0;
+        config->periods = 0;
+        config->ringMs = CAPTURE_RING_MS;
+        config->mixBlockMs = 0;
+        config->wakeThresholdMs = MIXER_WAKE_THRESHOLD_MS;
+        config->wakeTimeoutMs = MIXER_WAKE_TIMEOUT_MS;
+        break;
+    }
+}
+
+ma_result tcb_context_init(tcb_context *context, const tcb_context_config *config, const char *pFilePath, ma_device_id *pDeviceIds, ma_uint32 deviceCount)
 {
     ma_result result;
-    result = tcb_device_init(primaryDeviceId, &context->primary);
-    if (result != MA_SUCCESS)
+    context->stream = NULL;
+    context->wakeTimeoutMs = config->wakeTimeoutMs;
+    context->wakeups = 0;
+    context->mixLatencyCount = 0;
+    context->mixLatencyTotalNs = 0;
+    context->mixLatencyMaxNs = 0;
+    context->deviceCount = 0;
+    context->scratchFrames = 0;
+    atomic_init(&context->heapCalls, 0);
+    context->heapCallsBaseline = 0;
+    context->allocationCallbacks.pUserData = (void *)&context->heapCalls;
+    context->allocationCallbacks.onMalloc = tcb_counting_malloc;
+    context->allocationCallbacks.onRealloc = tcb_counting_realloc;
+    context->allocationCallbacks.onFree = tcb_counting_free;
+    context->startNs = 0;
+    context->statsFd = -1;
+    context->statsIntervalMs = config->statsIntervalMs;
+    context->driftCorrection = config->driftCorrection;
+    context->mixerPriority = config->mixerPriority;
+    context->mixerCpu = config->mixerCpu;
+    atomic_init(&context->running, false);
+    atomic_init(&context->errors, 0);
+    context->feedFd = -1;
+    context->feedStarted = false;
+    atomic_init(&context->feedRunning, false);
+    atomic_init(&context->feedDroppedFrames, 0);
+
+    context->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (context->wakeFd < 0)
     {
-        fprintf(stderr, "Failed to initialize primary device.\n");
-        return result;
+        fprintf(stderr, "Failed to create mixer wake descriptor.\n");
+        return MA_ERROR;
+    }
+
+    context->devices = calloc(deviceCount, sizeof(tcb_device));
+    context->mixSources = calloc(deviceCount, sizeof(ma_float *));
+    context->gains = calloc(deviceCount, sizeof(ma_float));
+    if (!context->devices || !context->mixSources || !context->gains)
+    {
+        fprintf(stderr, "Failed to allocate memory for devices.\n");
+        free(context->devices);
+        free(context->mixSources);
+        free(context->gains);
+        close(context->wakeFd);
+        return MA_OUT_OF_MEMORY;
+    }
+
+    for (ma_uint32 i = 0; i < deviceCount; i++)
+    {
+        context->gains[i] = (config->pGains != NULL && i < config->gainCount) ? config->pGains[i] : 1.0f;
     }
+    context->mixKernel = tcb_mix_kernel_select();
 
-    result = tcb_device_init(secundaryDeviceId, &context->secundary);
+    for (ma_uint32 i = 0; i < deviceCount; i++)
+    {
+        tcb_device *device = &context->devices[i];
+        result = tcb_device_init(config, &pDeviceIds[i], &context->allocationCallbacks, device);
+        if (result != MA_SUCCESS)
+        {
+            fprintf(stderr, "Failed to initialize device %u.\n", i);
+            for (ma_uint32 j = 0; j < context->deviceCount; j++)
+            {
+                tcb_device_uninit(&context->devices[j]);
+            }
+            free(context->devices);
+            free(context->mixSources);
+            free(context->gains);
+            close(context->wakeFd);
+            return result;
+        }
+        context->deviceCount++;
+
+        device->wakeFd = context->wakeFd;
+
+        /* One block is at most a full ring, whatever the rate of this source. */
+        ma_uint32 blockFrames = device->ringFrames;
+        if (config->mixBlockMs > 0)
+        {
+            blockFrames = ma_min(blockFrames, (ma_uint32)((ma_uint64)config->mixBlockMs * device->device.sampleRate / 1000));
+        }
+
+        ma_uint64 frameCountConverted;
+        if (ma_data_converter_get_expected_output_frame_count(&device->converter, blockFrames, &frameCountConverted) == MA_SUCCESS)
+        {
+            context->scratchFrames = ma_max(context->scratchFrames, frameCountConverted + 1);
+        }
+    }
+
+    /* One slot per source, each padded so every source starts on its own cache line. */
+    ma_uint64 slotFrames = ARENA_ALIGNMENT / sizeof(ma_float);
+    context->scratchFrames = (context->scratchFrames + slotFrames - 1) / slotFrames * slotFrames;
+    result = tcb_arena_init(&context->scratch, context->scratchFrames * deviceCount * sizeof(ma_float));
     if (result != MA_SUCCESS)
     {
-        fprintf(stderr, "Failed to initialize secundary device.\n");
+        fprintf(stderr, "Failed to allocate mixer scratch arena.\n");
+        for (ma_uint32 j = 0; j < context->deviceCount; j++)
+        {
+            tcb_device_uninit(&context->devices[j]);
+        }
+        free(context->devices);
+        free(context->mixSources);
+        free(context->gains);
+        close(context->wakeFd);
         return result;
     }
 
-    ma_encoder_config encoderConfig = ma_encoder_config_init(
-        ma_encoding_format_wav,
-        TARGET_FORMAT,
-        TARGET_CHANNELS,
-        TARGET_SAMPLE_RATE);
-
-    result = ma_encoder_init_file(pFilePath, &encoderConfig, &context->encoder);
+    tcb_writer_config writerConfig = tcb_writer_config_init(pFilePath, deviceCount);
+    writerConfig.format = config->format;
+    writerConfig.trackMode = config->trackMode;
+    writerConfig.segmentMs = config->segmentMs;
+    writerConfig.onFileClosed = config->onFileClosed;
+    writerConfig.pUserData = config->pUserData;
+    writerConfig.pAllocationCallbacks = &context->allocationCallbacks;
+    result = tcb_writer_init(&context->writer, &writerConfig);
     if (result != MA_SUCCESS)
     {
-        fprintf(stderr, "Failed to initialize output file.\n");
+        for (ma_uint32 j = 0; j < context->deviceCount; j++)
+        {
+            tcb_device_uninit(&context->devices[j]);
+        }
+        free(context->devices);
+        free(context->mixSources);
+        free(context->gains);
+        tcb_arena_uninit(&context->scratch);
+        close(context->wakeFd);
         return result;
     }
 
+    context->heapCallsBaseline = tcb_context_heap_calls(context);
+
     return MA_SUCCESS;
 }
 
-void tcb_context_uninit(tcb_context *context)
+static void tcb_context_stop_devices(tcb_context *context, ma_uint32 deviceCount)
 {
-    tcb_device_uninit(&context->primary);
-    tcb_device_uninit(&context->secundary);
-    ma_encoder_uninit(&context->encoder);
+    for (ma_uint32 i = 0; i < deviceCount; i++)
+    {
+        ma_device_stop(&context->devices[i].device);
+    }
 }
 
-void ensure_record_folder()
+/* Either everything runs or nothing does, a failed start leaves no device capturing. */
+ma_result tcb_context_start(tcb_context *context)
 {
-    char *home = getenv("HOME");
-    if (home == NULL)
+    for (ma_uint32 i = 0; i < context->deviceCount; i++)
     {
-        fprintf(stderr, "Failed to get HOME directory.\n");
-        exit(1);
+        if (tcb_device_start(&context->devices[i]) != MA_SUCCESS)
+        {
+            fprintf(stderr, "Failed to start device %u.\n", i);
+            tcb_context_stop_devices(context, i);
+            return MA_ERROR;
+        }
     }
 
-    char folder_path[512];
-    snprintf(folder_path, sizeof(folder_path), "%s/%s", home, RECORD_FOLDER);
+    if (tcb_context_start_mixer(context) != MA_SUCCESS)
+    {
+        tcb_context_stop_devices(context, context->deviceCount);
+        return MA_ERROR;
+    }
 
-    struct stat st;
-    if (stat(folder_path, &st) == -1)
+    return MA_SUCCESS;
+}
+
+/* Moves the mix from the feed ring into the transcription stream, whose lock the mixer must never wait on. */
+static void tcb_context_drain_feed(tcb_context *context)
+{
+    while (1)
     {
-        if (mkdir(folder_path, 0700) != 0)
+        ma_uint32 frameCount = ma_pcm_rb_available_read(&context->feedRb);
+        void *rbRead;
+        if (frameCount == 0 || ma_pcm_rb_acquire_read(&context->feedRb, &frameCount, &rbRead) != MA_SUCCESS || frameCount == 0)
         {
-            fprintf(stderr, "Failed to create folder: %s\n", folder_path);
-            exit(1);
+            break;
+        }
+
+        if (tcb_stream_push(context->stream, (const ma_float *)rbRead, frameCount) != MA_SUCCESS)
+        {
+            atomic_fetch_or_explicit(&context->errors, TCB_ERROR_STREAM_PUSH, memory_order_relaxed);
         }
+        ma_pcm_rb_commit_read(&context->feedRb, frameCount);
     }
 }
 
-void list_devices(ma_context *context)
+static void *tcb_context_feed_thread(void *arg)
 {
-    ma_device_info *pPlaybackDeviceInfos;
-    ma_uint32 playbackDeviceCount;
-    ma_device_info *pCaptureDeviceInfos;
-    ma_uint32 captureDeviceCount;
+    tcb_context *context = (tcb_context *)arg;
 
-    if (ma_context_get_devices(context, &pPlaybackDeviceInfos, &playbackDeviceCount, &pCaptureDeviceInfos, &captureDeviceCount) != MA_SUCCESS)
+    struct pollfd pfd = {.fd = context->feedFd, .events = POLLIN};
+    while (atomic_load(&context->feedRunning))
     {
-        fprintf(stderr, "Failed to retrieve device information.\n");
-        return;
+        if (poll(&pfd, 1, MIXER_WAKE_TIMEOUT_MS) > 0)
+        {
+            ma_uint64 wakeups;
+            if (read(context->feedFd, &wakeups, sizeof(wakeups)) != sizeof(wakeups))
+            {
+                continue;
+            }
+        }
+
+        tcb_context_drain_feed(context);
     }
 
-    printf("Playback Devices:\n");
-    for (ma_uint32 i = 0; i < playbackDeviceCount; ++i)
+    tcb_context_drain_feed(context);
+    return NULL;
+}
+
+static ma_result tcb_context_start_feed(tcb_context *context)
+{
+    ma_uint32 ringFrames = (ma_uint32)((ma_uint64)TARGET_SAMPLE_RATE * STREAM_FEED_RING_MS / 1000);
+    if (ma_pcm_rb_init(TARGET_FORMAT, TARGET_CHANNELS, ringFrames, NULL, &context->allocationCallbacks, &context->feedRb) != MA_SUCCESS)
     {
-        printf("    %u: %s\n", i, pPlaybackDeviceInfos[i].name);
+        fprintf(stderr, "Failed to initialize transcription ring buffer.\n");
+        return MA_ERROR;
     }
 
-    printf("\nCapture Devices:\n");
-    for (ma_uint32 i = 0; i < captureDeviceCount; ++i)
+    context->feedFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    atomic_store(&context->feedRunning, true);
+    if (context->feedFd < 0 || pthread_create(&context->feedThread, NULL, tcb_context_feed_thread, context) != 0)
     {
-        printf("    %u: %s\n", i, pCaptureDeviceInfos[i].name);
+        fprintf(stderr, "Failed to start transcription feed thread.\n");
+        atomic_store(&context->feedRunning, false);
+        if (context->feedFd >= 0)
+        {
+            close(context->feedFd);
+            context->feedFd = -1;
+        }
+        ma_pcm_rb_uninit(&context->feedRb);
+        return MA_ERROR;
     }
+    context->feedStarted = true;
+
+    return MA_SUCCESS;
 }
 
-void list_records()
+/* Called once the mixer has exited, so the last drain pushes everything it mixed. */
+static void tcb_context_stop_feed(tcb_context *context)
 {
-    char *home = getenv("HOME");
-    if (home == NULL)
+    if (!context->feedStarted)
     {
-        fprintf(stderr, "Error: HOME environment variable not set.\n");
         return;
     }
 
-    char folder_path[512];
-    snprintf(folder_path, sizeof(folder_path), "%s/%s", home, RECORD_FOLDER);
-
-    DIR *dir = opendir(folder_path);
-    if (dir == NULL)
+    atomic_store(&context->feedRunning, false);
+    ma_uint64 one = 1;
+    if (write(context->feedFd, &one, sizeof(one)) != sizeof(one))
     {
-        perror("Failed to open record folder");
-        fprintf(stderr, "Folder path: %s\n", folder_path);
-        return;
+        fprintf(stderr, "Failed to wake transcription feed thread.\n");
     }
+    pthread_join(context->feedThread, NULL);
+    close(context->feedFd);
+    context->feedFd = -1;
+    ma_pcm_rb_uninit(&context->feedRb);
+    context->feedStarted = false;
+}
 
-    printf("Available Records:\n");
-    struct dirent *entry;
-    int index = 0;
-    while ((entry = readdir(dir)) != NULL)
+/*
+ * Queues a mixed block for the feed thread. Runs on the mixer thread: it
+ * only copies into the preallocated ring, and drops and flags what does
+ * not fit rather than wait.
+ */
+static void tcb_context_feed(tcb_context *context, const ma_float *pFrames, ma_uint64 frameCount)
+{
+    ma_uint64 framesWritten = 0;
+    while (framesWritten < frameCount)
     {
-        char *filename = entry->d_name;
-        size_t filenameLen = strlen(filename);
-
-        if (filenameLen > 4 && strcmp(filename + filenameLen - 4, ".wav") == 0)
+        ma_uint32 framesToWrite = (ma_uint32)ma_min(frameCount - framesWritten, 0xFFFFFFFF);
+        void *rbWrite;
+        if (ma_pcm_rb_acquire_write(&context->feedRb, &framesToWrite, &rbWrite) != MA_SUCCESS || framesToWrite == 0)
         {
-            filename[filenameLen - 4] = '\0';
-            printf("    %d: %s\n", index, filename);
+            break;
+        }
 
-            index++;
+        memcpy(rbWrite, pFrames + framesWritten, framesToWrite * sizeof(ma_float));
+        if (ma_pcm_rb_commit_write(&context->feedRb, framesToWrite) != MA_SUCCESS)
+        {
+            break;
         }
+        framesWritten += framesToWrite;
+    }
+
+    if (framesWritten < frameCount)
+    {
+        atomic_fetch_add_explicit(&context->feedDroppedFrames, frameCount - framesWritten, memory_order_relaxed);
+        atomic_fetch_or_explicit(&context->errors, TCB_ERROR_STREAM_OVERFLOW, memory_order_relaxed);
     }
 
-    closedir(dir);
+    ma_uint64 one = 1;
+    if (write(context->feedFd, &one, sizeof(one)) != sizeof(one))
+    {
+        atomic_fetch_or_explicit(&context->errors, TCB_ERROR_STREAM_WAKE, memory_order_relaxed);
+    }
 }
 
-void rb_write_callback(ma_device *pDevice, void *pOutput, const void *pInput, ma_uint32 frameCount)
+/* Starts everything downstream of the device rings, whoever fills them. */
+ma_result tcb_context_start_mixer(tcb_context *context)
 {
-    ma_uint32 framesToWrite = frameCount;
-    ma_uint32 bytesPerFrame = ma_get_bytes_per_frame(pDevice->capture.format,
-                                                     pDevice->capture.channels);
-    ma_pcm_rb *rb = (ma_pcm_rb *)pDevice->pUserData;
-    MA_ASSERT(rb != NULL);
+    if (tcb_writer_start(&context->writer) != MA_SUCCESS)
+    {
+        return MA_ERROR;
+    }
 
-    void *rbWrite;
-    if (ma_pcm_rb_acquire_write(rb, &framesToWrite, &rbWrite) != MA_SUCCESS)
+    if (context->stream != NULL && tcb_context_start_feed(context) != MA_SUCCESS)
     {
-        fprintf(stderr, "Failed to acquire write buffer.\n");
-        return;
+        tcb_writer_stop(&context->writer);
+        return MA_ERROR;
     }
 
-    memcpy(rbWrite, pInput, framesToWrite * bytesPerFrame);
-    if (ma_pcm_rb_commit_write(rb, framesToWrite) != MA_SUCCESS)
+    /* The feed ring was just allocated, everything up to here is setup. */
+    context->heapCallsBaseline += tcb_context_heap_calls(context);
+    context->startNs = tcb_time_ns();
+    atomic_store(&context->running, true);
+    if (pthread_create(&context->thread, NULL, rb_read_thread, context) != 0)
     {
-        fprintf(stderr, "Failed to commit write buffer.\n");
+        fprintf(stderr, "Failed to start mixer thread.\n");
+        atomic_store(&context->running, false);
+        tcb_context_stop_feed(context);
+        tcb_writer_stop(&context->writer);
+        return MA_ERROR;
     }
-    
-    (void)pOutput;
+
+    if (context->mixerPriority > 0 || context->mixerCpu >= 0)
+    {
+        tcb_thread_set_realtime(context->thread, context->mixerPriority, context->mixerCpu);
+    }
+
+    if (context->statsIntervalMs > 0)
+    {
+        context->statsFd = eventfd(0, EFD_CLOEXEC);
+        if (context->statsFd < 0 || pthread_create(&context->statsThread, NULL, tcb_stats_thread, context) != 0)
+        {
+            fprintf(stderr, "Failed to start stats thread.\n");
+            if (context->statsFd >= 0)
+            {
+                close(context->statsFd);
+                context->statsFd = -1;
+            }
+        }
+    }
+
+    return MA_SUCCESS;
 }
 
-void *rb_read_thread(void *arg)
+void tcb_context_stop(tcb_context *context)
 {
-    tcb_context *tcbContext = (tcb_context *)arg;
-    assert(tcbContext != NULL);
+    tcb_context_stop_devices(context, context->deviceCount);
+    tcb_context_stop_mixer(context);
+
+    if (context->mixLatencyCount > 0)
+    {
+        printf("Mixer woke %llu times, latency avg %.2f ms, max %.2f ms\n",
+               (unsigned long long)context->wakeups,
+               (double)context->mixLatencyTotalNs / context->mixLatencyCount / 1e6,
+               (double)context->mixLatencyMaxNs / 1e6);
+    }
 
-    ma_uint32 bytesPerFrameNew = ma_get_bytes_per_frame(TARGET_FORMAT, TARGET_CHANNELS);
-    ma_pcm_rb *rb = &tcbContext->primary.rb;
-    ma_pcm_rb *rbSecundary = &tcbContext->secundary.rb;
-    ma_data_converter *converterPrimary = &tcbContext->primary.converter;
-    ma_data_converter *converterSecundary = &tcbContext->secundary.converter;
-    ma_encoder *encoder = &tcbContext->encoder;
-    assert(encoder != NULL);
+    printf("Mixer scratch %zu KiB, heap calls while recording: %llu\n",
+           context->scratch.capacity / 1024,
+           (unsigned long long)tcb_context_heap_calls(context));
 
-    while (1)
+    ma_uint64 droppedFrames = tcb_writer_dropped_frames(&context->writer);
+    if (droppedFrames > 0)
+    {
+        fprintf(stderr, "Writer fell behind and dropped %llu frames.\n", (unsigned long long)droppedFrames);
+    }
+
+    droppedFrames = atomic_load(&context->feedDroppedFrames);
+    if (droppedFrames > 0)
+    {
+        fprintf(stderr, "Transcription feed fell behind and dropped %llu frames.\n", (unsigned long long)droppedFrames);
+    }
+}
+
+/* Heap calls since the mixer started, through its allocators or the scratch arena. */
+ma_uint64 tcb_context_heap_calls(tcb_context *context)
+{
+    return atomic_load_explicit(&context->heapCalls, memory_order_relaxed) + context->scratch.heapCalls - context->heapCallsBaseline;
+}
+
+void tcb_context_stop_mixer(tcb_context *context)
+{
+    /* The mixer drains whatever the devices captured before exiting. */
+    atomic_store(&context->running, false);
+    ma_uint64 one = 1;
+    if (write(context->wakeFd, &one, sizeof(one)) != sizeof(one))
     {
-        ma_uint32 frameCountPrimary = ma_pcm_rb_available_read(rb);
-        ma_uint32 frameCountSecundary = ma_pcm_rb_available_read(rbSecundary);
-        ma_uint32 frameCount = ma_min(frameCountPrimary, frameCountSecundary);
+        fprintf(stderr, "Failed to wake mixer thread.\n");
+    }
+    pthread_join(context->thread, NULL);
 
-        if (frameCount > 0)
+    /* Freeing the feed ring is teardown, so it does not count against recording. */
+    ma_uint64 heapCalls = tcb_context_heap_calls(context);
+    tcb_context_stop_feed(context);
+    tcb_writer_stop(&context->writer);
+    context->heapCallsBaseline += tcb_context_heap_calls(context) - heapCalls;
+
+    if (context->statsFd >= 0)
+    {
+        if (write(context->statsFd, &one, sizeof(one)) != sizeof(one))
         {
-            void *rbRead, *rbOtherRead;
-            if (ma_pcm_rb_acquire_read(rb, &frameCount, &rbRead) == MA_SUCCESS &&
-                ma_pcm_rb_acquire_read(rbSecundary, &frameCount, &rbOtherRead) == MA_SUCCESS)
-            {
+            fprintf(stderr, "Failed to wake stats thread.\n");
+        }
+        pthread_join(context->statsThread, NULL);
+        close(context->statsFd);
+        context->statsFd = -1;
+        tcb_stats_print(context, stderr);
+    }
 
-                ma_int16 *rbBuffer = (ma_int16 *)rbRead;
-                ma_int16 *rbOtherBuffer = (ma_int16 *)rbOtherRead;
+    tcb_context_report_errors(context);
+}
 
-                ma_uint64 frameCountOld = frameCount;
-                ma_uint64 frameCountConvertedPrimary, frameCountConvertedSecundary;
+void tcb_context_uninit(tcb_context *context)
+{
+    for (ma_uint32 i = 0; i < context->deviceCount; i++)
+    {
+        tcb_device_uninit(&context->devices[i]);
+    }
+    free(context->devices);
+    free(context->mixSources);
+    free(context->gains);
+    context->devices = NULL;
+    context->mixSources = NULL;
+    context->gains = NULL;
+    context->deviceCount = 0;
+    tcb_arena_uninit(&context->scratch);
+    tcb_writer_uninit(&context->writer);
+    close(context->wakeFd);
+}
 
-                if (ma_data_converter_get_expected_output_frame_count(converterPrimary, frameCountOld, &frameCountConvertedPrimary) != MA_SUCCESS ||
-                    ma_data_converter_get_expected_output_frame_count(converterSecundary, frameCountOld, &frameCountConvertedSecundary) != MA_SUCCESS)
-                {
-                    fprintf(stderr, "Failed to get expected output frame count.\n");
-                    ma_pcm_rb_commit_read(rb, frameCount);
-                    ma_pcm_rb_commit_read(rbSecundary, frameCount);
-                    continue;
-                }
+ma_uint64 tcb_time_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ma_uint64)ts.tv_sec * 1000000000ull + (ma_uint64)ts.tv_nsec;
+}
 
-                ma_uint64 frameCountConverted = ma_min(frameCountConvertedPrimary, frameCountConvertedSecundary);
-                ma_float *rbBufferConverted = malloc(frameCountConverted * bytesPerFrameNew);
-                ma_float *rbOtherBufferConverted = malloc(frameCountConverted * bytesPerFrameNew);
-                if (!rbBufferConverted || !rbOtherBufferConverted)
-                {
-                    fprintf(stderr, "Failed to allocate memory for converted buffers\n");
-                    ma_pcm_rb_commit_read(rb, frameCount);
-                    ma_pcm_rb_commit_read(rbSecundary, frameCount);
-                    continue;
-                }
+static bool tcb_read_sysfs_int(const char *pPath, int *pValue)
+{
+    FILE *file = fopen(pPath, "r");
+    if (file == NULL)
+    {
+        return false;
+    }
 
-                ma_uint64 framesConvertedPrimary = frameCountConverted;
-                ma_uint64 framesConvertedSecundary = frameCountConverted;
+    bool ok = fscanf(file, "%d", pValue) == 1;
+    fclose(file);
+    return ok;
+}
 
-                if (ma_data_converter_process_pcm_frames(converterPrimary, rbBuffer, &frameCountOld, rbBufferConverted, &framesConvertedPrimary) != MA_SUCCESS ||
-                    (frameCountOld = frameCount,
-                     ma_data_converter_process_pcm_frames(converterSecundary, rbOtherBuffer, &frameCountOld, rbOtherBufferConverted, &framesConvertedSecundary) != MA_SUCCESS))
-                {
-                    fprintf(stderr, "Failed to convert buffer(s).\n");
-                    free(rbBufferConverted);
-                    free(rbOtherBufferConverted);
-                    ma_pcm_rb_commit_read(rb, frameCount);
-                    ma_pcm_rb_commit_read(rbSecundary, frameCount);
-                    continue;
-                }
+/*
+ * Physical cores this process may run on. Hyperthread siblings share one
+ * core's vector units and whisper gains nothing from them, so every CPU is
+ * folded into its (package, core) pair.
+ */
+ma_uint32 tcb_cpu_cores(void)
+{
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) != 0)
+    {
+        return (ma_uint32)ma_max(1, sysconf(_SC_NPROCESSORS_ONLN));
+    }
 
-                for (ma_uint32 i = 0; i < frameCountConverted; i++)
-                {
-                    rbBufferConverted[i] = ma_clamp((rbBufferConverted[i] + rbOtherBufferConverted[i]), -1.0f, 1.0f);
-                }
+    int cores[CPU_SETSIZE][2];
+    ma_uint32 coreCount = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (!CPU_ISSET(cpu, &set))
+        {
+            continue;
+        }
 
-                ma_uint64 framesWritten;
-                if (ma_encoder_write_pcm_frames(encoder, rbBufferConverted, frameCountConverted, &framesWritten) != MA_SUCCESS)
-                {
-                    fprintf(stderr, "Failed to write to encoder.\n");
-                }
+        char path[128];
+        int package = -1;
+        int core = -1;
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+        bool known = tcb_read_sysfs_int(path, &package);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        known = tcb_read_sysfs_int(path, &core) && known;
+        if (!known)
+        {
+            /* Without topology every CPU counts as its own core. */
+            package = -1;
+            core = cpu;
+        }
 
-                ma_pcm_rb_commit_read(rb, frameCount);
-                ma_pcm_rb_commit_read(rbSecundary, frameCount);
-                free(rbBufferConverted);
-                free(rbOtherBufferConverted);
-            }
+        ma_uint32 i = 0;
+        while (i < coreCount && (cores[i][0] != package || cores[i][1] != core))
+        {
+            i++;
+        }
+
+        if (i == coreCount)
+        {
+            cores[coreCount][0] = package;
+            cores[coreCount][1] = core;
+            coreCount++;
         }
-        sleep(0.5);
     }
-    return NULL;
-}
 
-static void cb_log_disable(enum ggml_log_level, const char *, void *) {}
+    return ma_max(coreCount, 1);
+}
 
-int main(int argc, char **argv)
+void tcb_split_cores(int *pJobs, int *pThreads)
 {
-    ensure_record_folder();
+    int cores = (int)tcb_cpu_cores();
+    if (*pJobs <= 0)
+    {
+        *pJobs = ma_max(1, cores / (*pThreads > 0 ? *pThreads : WHISPER_JOB_THREADS));
+    }
 
-    ma_context context;
-    if (ma_context_init(NULL, 0, NULL, &context) != MA_SUCCESS)
+    if (*pThreads <= 0)
     {
-        fprintf(stderr, "Failed to initialize context.\n");
-        return -1;
+        *pThreads = ma_max(1, cores / *pJobs);
     }
+}
 
-    if (argc < 2)
+/*
+ * Moves a thread to SCHED_FIFO at priority and pins it to cpu, either one
+ * may be skipped with 0 or -1. Without CAP_SYS_NICE the kernel allows up to
+ * RLIMIT_RTPRIO, so the soft limit is raised to the hard one first.
+ */
+ma_result tcb_thread_set_realtime(pthread_t thread, int priority, int cpu)
+{
+    ma_result result = MA_SUCCESS;
+    if (priority > 0)
     {
-        printf("Usage: %s <command> [options]\n", argv[0]);
-        printf("Commands:\n");
-        printf("    list-devices            List available devices\n");
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_RTPRIO, &limit) == 0 && limit.rlim_cur < (rlim_t)priority && limit.rlim_cur < limit.rlim_max)
+        {
+            limit.rlim_cur = limit.rlim_max;
+            setrlimit(RLIMIT_RTPRIO, &limit);
+        }
+
+        struct sched_param param = {.sched_priority = ma_clamp(priority, sched_get_priority_min(SCHED_FIFO), sched_get_priority_max(SCHED_FIFO))};
+        int error = pthread_setschedparam(thread, SCHED_FIFO, &param);
+        if (error != 0)
+        {
+            fprintf(stderr, "Failed to set real-time priority %d: %s\n", param.sched_priority, strerror(error));
+            if (error == EPERM)
+            {
+                fprintf(stderr, "Grant an rtprio limit in /etc/security/limits.conf or CAP_SYS_NICE to use it.\n");
+            }
+            result = MA_ERROR;
+        }
+    }
+
+    if (cpu >= 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        int error = pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+        if (error != 0)
+        {
+            fprintf(stderr, "Failed to pin thread to CPU %d: %s\n", cpu, strerror(error));
+            result = MA_ERROR;
+        }
+    }
+
+    return result;
+}
+
+void ensure_record_folder()
+{
+    char *home = getenv("HOME");
+    if (home == NULL)
+    {
+        fprintf(stderr, "Failed to get HOME directory.\n");
+        exit(1);
+    }
+
+    char folder_path[512];
+    snprintf(folder_path, sizeof(folder_path), "%s/%s", home, RECORD_FOLDER);
+
+    struct stat st;
+    if (stat(folder_path, &st) == -1)
+    {
+        if (mkdir(folder_path, 0700) != 0)
+        {
+            fprintf(stderr, "Failed to create folder: %s\n", folder_path);
+            exit(1);
+        }
+    }
+}
+
+void list_devices(ma_context *context)
+{
+    ma_device_info *pPlaybackDeviceInfos;
+    ma_uint32 playbackDeviceCount;
+    ma_device_info *pCaptureDeviceInfos;
+    ma_uint32 captureDeviceCount;
+
+    if (ma_context_get_devices(context, &pPlaybackDeviceInfos, &playbackDeviceCount, &pCaptureDeviceInfos, &captureDeviceCount) != MA_SUCCESS)
+    {
+        fprintf(stderr, "Failed to retrieve device information.\n");
+        return;
+    }
+
+    printf("Playback Devices:\n");
+    for (ma_uint32 i = 0; i < playbackDeviceCount; ++i)
+    {
+        printf("    %u: %s\n", i, pPlaybackDeviceInfos[i].name);
+    }
+
+    printf("\nCapture Devices:\n");
+    for (ma_uint32 i = 0; i < captureDeviceCount; ++i)
+    {
+        printf("    %u: %s\n", i, pCaptureDeviceInfos[i].name);
+    }
+}
+
+/*
+ * Recordings are the mix files. The per-device copies --tracks writes next
+ * to them (name.tracks.wav, name.track1.wav, name.part000.track1.wav) hold
+ * the same audio and are not recordings of their own. Segments written by
+ * --segment (name.part000.wav) are, there is no other file of their audio.
+ */
+bool tcb_is_record_file(const char *pFileName)
+{
+    const char *dot = strrchr(pFileName, '.');
+    if (dot == NULL || dot == pFileName)
+    {
+        return false;
+    }
+
+    if (strcmp(dot, ".wav") != 0 && strcmp(dot, ".flac") != 0 && strcmp(dot, ".opus") != 0)
+    {
+        return false;
+    }
+
+    const char *suffix = dot;
+    while (suffix > pFileName && suffix[-1] != '.')
+    {
+        suffix--;
+    }
+    if (suffix == pFileName)
+    {
+        return true;
+    }
+
+    if (strncmp(suffix, "tracks.", 7) == 0)
+    {
+        return false;
+    }
+    if (strncmp(suffix, "track", 5) == 0 && suffix + 5 < dot && strspn(suffix + 5, "0123456789") == (size_t)(dot - suffix - 5))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void rb_write_callback(ma_device *pDevice, void *pOutput, const void *pInput, ma_uint32 frameCount)
+{
+    ma_uint32 bytesPerFrame = ma_get_bytes_per_frame(pDevice->capture.format,
+                                                     pDevice->capture.channels);
+    tcb_device *device = (tcb_device *)pDevice->pUserData;
+    MA_ASSERT(device != NULL);
+    tcb_device_stats *stats = &device->stats;
+
+    /* Jitter is the distance between the callback interval and the period it delivered. */
+    ma_uint64 nowNs = tcb_time_ns();
+    if (device->lastCallbackNs != 0)
+    {
+        ma_uint64 intervalNs = nowNs - device->lastCallbackNs;
+        ma_uint64 periodNs = (ma_uint64)frameCount * 1000000000ull / pDevice->sampleRate;
+        ma_uint64 jitterNs = intervalNs > periodNs ? intervalNs - periodNs : periodNs - intervalNs;
+        atomic_fetch_add_explicit(&stats->jitterTotalNs, jitterNs, memory_order_relaxed);
+        if (jitterNs > atomic_load_explicit(&stats->jitterMaxNs, memory_order_relaxed))
+        {
+            atomic_store_explicit(&stats->jitterMaxNs, jitterNs, memory_order_relaxed);
+        }
+    }
+    device->lastCallbackNs = nowNs;
+    atomic_fetch_add_explicit(&stats->callbacks, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->framesCaptured, frameCount, memory_order_relaxed);
+
+    /* The ring hands out one contiguous region at a time, so a wrap needs a second pass. */
+    ma_uint32 framesWritten = 0;
+    while (framesWritten < frameCount)
+    {
+        ma_uint32 framesToWrite = frameCount - framesWritten;
+        void *rbWrite;
+        if (ma_pcm_rb_acquire_write(&device->rb, &framesToWrite, &rbWrite) != MA_SUCCESS)
+        {
+            atomic_fetch_or_explicit(&stats->errors, TCB_ERROR_RING_ACQUIRE, memory_order_relaxed);
+            break;
+        }
+
+        if (framesToWrite == 0)
+        {
+            break;
+        }
+
+        memcpy(rbWrite, (const ma_uint8 *)pInput + (size_t)framesWritten * bytesPerFrame, (size_t)framesToWrite * bytesPerFrame);
+        if (ma_pcm_rb_commit_write(&device->rb, framesToWrite) != MA_SUCCESS)
+        {
+            atomic_fetch_or_explicit(&stats->errors, TCB_ERROR_RING_COMMIT, memory_order_relaxed);
+            break;
+        }
+        framesWritten += framesToWrite;
+    }
+
+    if (framesWritten < frameCount)
+    {
+        atomic_fetch_add_explicit(&stats->framesDropped, frameCount - framesWritten, memory_order_relaxed);
+    }
+
+    ma_uint32 fill = ma_pcm_rb_available_read(&device->rb);
+    if (fill > atomic_load_explicit(&stats->fillHighWater, memory_order_relaxed))
+    {
+        atomic_store_explicit(&stats->fillHighWater, fill, memory_order_relaxed);
+    }
+
+    /* Only this callback touches pendingFrames, the mixer is woken once per threshold. */
+    device->pendingFrames += framesWritten;
+    if (device->pendingFrames >= device->wakeThresholdFrames)
+    {
+        device->pendingFrames = 0;
+        ma_uint64 expected = 0;
+        atomic_compare_exchange_strong(&device->wakeTimeNs, &expected, nowNs);
+
+        ma_uint64 one = 1;
+        if (write(device->wakeFd, &one, sizeof(one)) != sizeof(one))
+        {
+            atomic_fetch_or_explicit(&stats->errors, TCB_ERROR_MIXER_WAKE, memory_order_relaxed);
+        }
+    }
+
+    (void)pOutput;
+}
+
+ma_uint64 tcb_context_mix(tcb_context *tcbContext)
+{
+    ma_uint32 deviceCount = tcbContext->deviceCount;
+
+    ma_uint64 framesMixed = 0;
+    while (deviceCount > 0)
+    {
+        /* Block size is what every source can deliver at the target rate. */
+        ma_uint64 frameCount = ~(ma_uint64)0;
+        for (ma_uint32 d = 0; d < deviceCount; d++)
+        {
+            ma_uint64 frameCountConverted;
+            ma_uint32 frameCountIn = ma_pcm_rb_available_read(&tcbContext->devices[d].rb);
+            tcb_device_stats *stats = &tcbContext->devices[d].stats;
+            if (frameCountIn > atomic_load_explicit(&stats->mixerLagMaxFrames, memory_order_relaxed))
+            {
+                atomic_store_explicit(&stats->mixerLagMaxFrames, frameCountIn, memory_order_relaxed);
+            }
+
+            if (ma_data_converter_get_expected_output_frame_count(&tcbContext->devices[d].converter, frameCountIn, &frameCountConverted) != MA_SUCCESS)
+            {
+                frameCountConverted = 0;
+            }
+            frameCount = ma_min(frameCount, frameCountConverted);
+        }
+
+        if (frameCount == 0)
+        {
+            break;
+        }
+
+        /* Sources are converted back to back so the mix streams through contiguous memory. */
+        ma_uint64 stride = tcbContext->scratchFrames;
+        frameCount = ma_min(frameCount, stride);
+        tcb_arena_reset(&tcbContext->scratch);
+        ma_float *converted = tcb_arena_alloc(&tcbContext->scratch, stride * deviceCount * sizeof(ma_float));
+        assert(converted != NULL);
+
+        for (ma_uint32 d = 0; d < deviceCount; d++)
+        {
+            ma_float *source = converted + d * stride;
+            ma_uint64 framesRead = tcb_device_read_converted(&tcbContext->devices[d], source, frameCount);
+            memset(source + framesRead, 0, (frameCount - framesRead) * sizeof(ma_float));
+            if (framesRead < frameCount)
+            {
+                atomic_fetch_add_explicit(&tcbContext->devices[d].stats.underrunFrames, frameCount - framesRead, memory_order_relaxed);
+            }
+            tcbContext->mixSources[d] = source;
+        }
+
+        /* Tracks are queued before the mix overwrites the first source in place. */
+        tcb_writer_write_sources(&tcbContext->writer, tcbContext->mixSources, deviceCount, frameCount);
+        tcbContext->mixKernel->proc(converted, tcbContext->mixSources, tcbContext->gains, deviceCount, frameCount);
+        if (tcb_writer_write_mix(&tcbContext->writer, converted, frameCount) != MA_SUCCESS)
+        {
+            atomic_fetch_or_explicit(&tcbContext->errors, TCB_ERROR_WRITER_WAKE, memory_order_relaxed);
+        }
+
+        if (tcbContext->feedStarted)
+        {
+            tcb_context_feed(tcbContext, converted, frameCount);
+        }
+
+        framesMixed += frameCount;
+    }
+
+    if (framesMixed > 0)
+    {
+        tcb_context_correct_drift(tcbContext);
+    }
+
+    /* Latency is measured from the oldest unserved wake-up to the end of the mix. */
+    ma_uint64 wakeTimeNs = 0;
+    for (ma_uint32 d = 0; d < deviceCount; d++)
+    {
+        ma_uint64 deviceWakeTimeNs = atomic_exchange(&tcbContext->devices[d].wakeTimeNs, 0);
+        if (deviceWakeTimeNs != 0 && (wakeTimeNs == 0 || deviceWakeTimeNs < wakeTimeNs))
+        {
+            wakeTimeNs = deviceWakeTimeNs;
+        }
+    }
+
+    if (framesMixed > 0 && wakeTimeNs != 0)
+    {
+        ma_uint64 latencyNs = tcb_time_ns() - wakeTimeNs;
+        tcbContext->mixLatencyCount++;
+        tcbContext->mixLatencyTotalNs += latencyNs;
+        tcbContext->mixLatencyMaxNs = ma_max(tcbContext->mixLatencyMaxNs, latencyNs);
+    }
+
+    return framesMixed;
+}
+
+/*
+ * Sets the resampler to nominalRatio * (1 + correction). set_rate_ratio
+ * would round the ratio to a fraction over about 1000, steps of hundreds of
+ * ppm, so both rates are scaled up instead: the linear resampler advances
+ * by exactly rateIn / rateOut, and rateOut stays below 2^31 so its
+ * fractional position cannot overflow.
+ */
+static void tcb_device_set_rate(tcb_device *device, double correction)
+{
+    const ma_uint32 scale = DRIFT_RATE_LIMIT / ma_max(device->device.sampleRate, TARGET_SAMPLE_RATE);
+    const ma_uint32 rateIn = device->device.sampleRate * scale;
+    const ma_uint32 rateOut = (ma_uint32)llround((double)TARGET_SAMPLE_RATE * scale / (1.0 + correction));
+    const double ratio = (double)rateIn / rateOut;
+    if (ratio != device->rateRatio && ma_data_converter_set_rate(&device->converter, rateIn, rateOut) == MA_SUCCESS)
+    {
+        device->rateRatio = ratio;
+    }
+}
+
+/*
+ * Device 0 is the master clock. Every other source is nudged through its
+ * resampler so its backlog matches the master's: a source that keeps more
+ * frames waiting runs fast and must consume more input per output frame.
+ * The integral term converges to the relative clock offset.
+ */
+void tcb_context_correct_drift(tcb_context *context)
+{
+    if (!context->driftCorrection || context->deviceCount < 2)
+    {
+        return;
+    }
+
+    ma_uint64 nowNs = tcb_time_ns();
+    tcb_device *master = &context->devices[0];
+    double masterFill = (double)ma_pcm_rb_available_read(&master->rb) / master->device.sampleRate;
+    double maxCorrection = DRIFT_MAX_PPM / 1e6;
+
+    for (ma_uint32 d = 1; d < context->deviceCount; d++)
+    {
+        tcb_device *device = &context->devices[d];
+        double dt = device->driftLastNs != 0 ? (double)(nowNs - device->driftLastNs) / 1e9 : 0.0;
+        device->driftLastNs = nowNs;
+        if (dt <= 0.0)
+        {
+            continue;
+        }
+        dt = ma_min(dt, 1.0);
+
+        double fill = (double)ma_pcm_rb_available_read(&device->rb) / device->device.sampleRate;
+        device->driftError += (fill - masterFill - device->driftError) * ma_min(1.0, dt * 1000.0 / DRIFT_FILTER_MS);
+        device->driftIntegral = ma_clamp(device->driftIntegral + DRIFT_KI * device->driftError * dt, -maxCorrection, maxCorrection);
+
+        tcb_device_set_rate(device, ma_clamp(DRIFT_KP * device->driftError + device->driftIntegral, -maxCorrection, maxCorrection));
+
+        /* What the resampler actually applies, not what the controller asked for. */
+        atomic_store_explicit(&device->stats.driftPpm, (float)((device->rateRatio / device->nominalRatio - 1.0) * 1e6), memory_order_relaxed);
+    }
+}
+
+void *rb_read_thread(void *arg)
+{
+    tcb_context *tcbContext = (tcb_context *)arg;
+    assert(tcbContext != NULL);
+
+    struct pollfd pfd = {.fd = tcbContext->wakeFd, .events = POLLIN};
+    while (atomic_load(&tcbContext->running))
+    {
+        /* The timeout bounds latency if a device stalls below the wake threshold. */
+        if (poll(&pfd, 1, (int)tcbContext->wakeTimeoutMs) > 0)
+        {
+            ma_uint64 wakeups;
+            if (read(tcbContext->wakeFd, &wakeups, sizeof(wakeups)) == sizeof(wakeups))
+            {
+                tcbContext->wakeups += wakeups;
+            }
+        }
+
+        tcb_context_mix(tcbContext);
+    }
+
+    tcb_context_mix(tcbContext);
+    return NULL;
+}
+
+static void cb_log_disable(enum ggml_log_level, const char *, void *) {}
+
+static bool tcb_gpu_available(void)
+{
+#ifdef GGML_USE_CUDA
+    return ggml_backend_cuda_get_device_count() > 0;
+#else
+    return false;
+#endif
+}
+
+static struct whisper_context *tcb_whisper_load(bool use_gpu, bool with_state)
+{
+    /* A host without a usable GPU still transcribes, only slower. */
+    if (use_gpu && !tcb_gpu_available())
+    {
+#ifdef GGML_USE_CUDA
+        fprintf(stderr, "No CUDA device found, transcribing on the CPU.\n");
+#else
+        fprintf(stderr, "Built without GPU support, transcribing on the CPU.\n");
+#endif
+        use_gpu = false;
+    }
+
+    char *home = getenv("HOME");
+    char model_path[512];
+    snprintf(model_path, sizeof(model_path), "%s/%s/%s", home, RECORD_FOLDER, MODEL_FILE);
+    whisper_log_set(cb_log_disable, NULL);
+
+    struct whisper_context_params cparams = whisper_context_default_params();
+    cparams.use_gpu = use_gpu;
+    cparams.flash_attn = true;
+    cparams.dtw_aheads_preset = WHISPER_AHEADS_LARGE_V3_TURBO;
+    struct whisper_context *ctx = with_state
+                                      ? whisper_init_from_file_with_params(model_path, cparams)
+                                      : whisper_init_from_file_with_params_no_state(model_path, cparams);
+    if (!ctx)
+    {
+        fprintf(stderr, "Failed to initialize whisper context.\n");
+    }
+
+    return ctx;
+}
+
+struct whisper_context *tcb_whisper_init(bool use_gpu)
+{
+    return tcb_whisper_load(use_gpu, true);
+}
+
+struct whisper_context *tcb_whisper_init_shared(bool use_gpu)
+{
+    return tcb_whisper_load(use_gpu, false);
+}
+
+int tcb_whisper_full(struct whisper_context *ctx, struct whisper_state *state, struct whisper_full_params params, const float *samples, int sampleCount)
+{
+    return state != NULL ? whisper_full_with_state(ctx, state, params, samples, sampleCount)
+                         : whisper_full(ctx, params, samples, sampleCount);
+}
+
+int tcb_whisper_n_segments(struct whisper_context *ctx, struct whisper_state *state)
+{
+    return state != NULL ? whisper_full_n_segments_from_state(state) : whisper_full_n_segments(ctx);
+}
+
+const char *tcb_whisper_segment(struct whisper_context *ctx, struct whisper_state *state, int i, ma_int64 *pT0Ms, ma_int64 *pT1Ms)
+{
+    if (state != NULL)
+    {
+        *pT0Ms = whisper_full_get_segment_t0_from_state(state, i) * 10;
+        *pT1Ms = whisper_full_get_segment_t1_from_state(state, i) * 10;
+        return whisper_full_get_segment_text_from_state(state, i);
+    }
+
+    *pT0Ms = whisper_full_get_segment_t0(ctx, i) * 10;
+    *pT1Ms = whisper_full_get_segment_t1(ctx, i) * 10;
+    return whisper_full_get_segment_text(ctx, i);
+}
+
+/*
+ * Average log-probability of the text tokens of segment i. pEntropy gets
+ * the entropy of its last REFINE_ENTROPY_TOKENS text tokens, low when the
+ * decoder got stuck repeating itself, or INFINITY for a shorter segment.
+ */
+float tcb_whisper_segment_logprob(struct whisper_context *ctx, struct whisper_state *state, int i, float *pEntropy)
+{
+    const int tokenCount = state != NULL ? whisper_full_n_tokens_from_state(state, i) : whisper_full_n_tokens(ctx, i);
+    const whisper_token eot = whisper_token_eot(ctx);
+    whisper_token recent[REFINE_ENTROPY_TOKENS];
+    int textTokens = 0;
+    double logprob = 0.0;
+    for (int j = 0; j < tokenCount; j++)
+    {
+        whisper_token_data token = state != NULL ? whisper_full_get_token_data_from_state(state, i, j) : whisper_full_get_token_data(ctx, i, j);
+        if (token.id >= eot)
+        {
+            /* Timestamps and other special tokens. */
+            continue;
+        }
+        logprob += token.plog;
+        recent[textTokens % REFINE_ENTROPY_TOKENS] = token.id;
+        textTokens++;
+    }
+
+    *pEntropy = INFINITY;
+    if (textTokens >= REFINE_ENTROPY_TOKENS)
+    {
+        double entropy = 0.0;
+        for (int a = 0; a < REFINE_ENTROPY_TOKENS; a++)
+        {
+            /* Every distinct token is counted once, at its first position. */
+            bool seen = false;
+            int count = 0;
+            for (int b = 0; b < REFINE_ENTROPY_TOKENS && !seen; b++)
+            {
+                seen = recent[b] == recent[a] && b < a;
+                count += recent[b] == recent[a] ? 1 : 0;
+            }
+
+            if (!seen)
+            {
+                double p = (double)count / REFINE_ENTROPY_TOKENS;
+                entropy -= p * log(p);
+            }
+        }
+        *pEntropy = (float)entropy;
+    }
+
+    return textTokens > 0 ? (float)(logprob / textTokens) : 0.0f;
+}
+
+/* Adds the text tokens of segment i, with their probabilities, to the last segment of entry. */
+ma_result tcb_whisper_segment_tokens(struct whisper_context *ctx, struct whisper_state *state, int i, tcb_cache_entry *entry)
+{
+    const int tokenCount = state != NULL ? whisper_full_n_tokens_from_state(state, i) : whisper_full_n_tokens(ctx, i);
+    const whisper_token eot = whisper_token_eot(ctx);
+    for (int j = 0; j < tokenCount; j++)
+    {
+        whisper_token_data token = state != NULL ? whisper_full_get_token_data_from_state(state, i, j) : whisper_full_get_token_data(ctx, i, j);
+        if (token.id >= eot)
+        {
+            continue;
+        }
+
+        const char *text = state != NULL ? whisper_full_get_token_text_from_state(ctx, state, i, j) : whisper_full_get_token_text(ctx, i, j);
+        if (tcb_cache_entry_append_token(entry, token.id, token.p, text) != MA_SUCCESS)
+        {
+            return MA_OUT_OF_MEMORY;
+        }
+    }
+
+    return MA_SUCCESS;
+}
+
+/* Greedy decoding; the stream refines what it is unsure of with beam search. */
+struct whisper_full_params tcb_whisper_params(const char *language)
+{
+    struct whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
+    wparams.language = language;
+    wparams.n_threads = (int)tcb_cpu_cores();
+
+    return wparams;
+}
+
+void tcb_format_timestamp(char *buffer, size_t bufferSize, ma_int64 ms)
+{
+    ma_int64 hours = ms / 3600000;
+    ma_int64 minutes = (ms / 60000) % 60;
+    ma_int64 seconds = (ms / 1000) % 60;
+    snprintf(buffer, bufferSize, "%02lld:%02lld:%02lld.%03lld", (long long)hours, (long long)minutes, (long long)seconds, (long long)(ms % 1000));
+}
+
+ma_result tcb_transcript_path(const char *pFilePath, char *pOutputPath, size_t outputPathSize)
+{
+    const char *dot = strrchr(pFilePath, '.');
+    const char *slash = strrchr(pFilePath, '/');
+    if (!dot || dot == pFilePath || (slash != NULL && dot < slash))
+    {
+        fprintf(stderr, "Error: input file does not have a valid extension\n");
+        return MA_INVALID_ARGS;
+    }
+
+    if ((size_t)snprintf(pOutputPath, outputPathSize, "%.*s.txt", (int)(dot - pFilePath), pFilePath) >= outputPathSize)
+    {
+        fprintf(stderr, "Error: output path is too long\n");
+        return MA_INVALID_ARGS;
+    }
+
+    return MA_SUCCESS;
+}
+
+void tcb_print_segment(void *pUserData, ma_int64 t0Ms, ma_int64 t1Ms, const char *text)
+{
+    printf("%s\n", text);
+    (void)pUserData;
+    (void)t0Ms;
+    (void)t1Ms;
+}
+
+void tcb_print_timestamped_segment(void *pUserData, ma_int64 t0Ms, ma_int64 t1Ms, const char *text)
+{
+    char start[32], end[32];
+    tcb_format_timestamp(start, sizeof(start), t0Ms);
+    tcb_format_timestamp(end, sizeof(end), t1Ms);
+    printf("[%s --> %s] %s\n", start, end, text);
+    (void)pUserData;
+}
+
+/*
+ * The file key of an input, without decoding it: from the alias stored the
+ * last time it was transcribed, or by hashing it in place when it is a
+ * WAV that can be mapped. MA_DOES_NOT_EXIST otherwise.
+ */
+static ma_result tcb_transcribe_file_key(struct whisper_full_params params, const char *pFilePath, ma_uint64 *pKey)
+{
+    ma_uint64 alias = tcb_cache_alias_key(&params, pFilePath);
+    if (alias != 0 && tcb_cache_alias_load(alias, pKey) == MA_SUCCESS)
+    {
+        return MA_SUCCESS;
+    }
+
+    tcb_mapped_wav map;
+    if (tcb_mapped_wav_open(&map, pFilePath) != MA_SUCCESS)
+    {
+        return MA_DOES_NOT_EXIST;
+    }
+
+    *pKey = tcb_cache_key(&params, "file", map.pFrames, map.frameCount);
+    tcb_mapped_wav_close(&map);
+    return MA_SUCCESS;
+}
+
+/* Stores a finished transcript under its file key, and the alias that finds it next time without decoding. */
+static void tcb_transcribe_file_store(struct whisper_full_params params, const char *pFilePath, ma_uint64 key, const tcb_cache_entry *entry)
+{
+    if (tcb_cache_store(key, entry) != MA_SUCCESS)
+    {
+        return;
+    }
+
+    ma_uint64 alias = tcb_cache_alias_key(&params, pFilePath);
+    if (alias != 0)
+    {
+        tcb_cache_alias_store(alias, key);
+    }
+}
+
+/*
+ * Writes the transcript of a file transcribed before with the same model
+ * and parameters, in every format in formats, without loading the model.
+ * MA_DOES_NOT_EXIST on a miss.
+ */
+ma_result tcb_transcribe_cached(struct whisper_full_params params, ma_uint32 formats, const char *pFilePath, char *pOutputPath, size_t outputPathSize, tcb_segment_proc onSegment, void *pUserData)
+{
+    ma_uint64 key;
+    tcb_cache_entry entry;
+    memset(&entry, 0, sizeof(entry));
+    if (tcb_transcript_path(pFilePath, pOutputPath, outputPathSize) != MA_SUCCESS ||
+        tcb_transcribe_file_key(params, pFilePath, &key) != MA_SUCCESS ||
+        tcb_cache_load(key, &entry) != MA_SUCCESS)
+    {
+        tcb_cache_entry_uninit(&entry);
+        return MA_DOES_NOT_EXIST;
+    }
+
+    tcb_transcript_writer writer;
+    if (tcb_transcript_writer_open(&writer, pOutputPath, formats, false) != MA_SUCCESS)
+    {
+        tcb_cache_entry_uninit(&entry);
+        return MA_ERROR;
+    }
+
+    tcb_transcript transcript;
+    memset(&transcript, 0, sizeof(transcript));
+    ma_result result = MA_SUCCESS;
+    for (size_t i = 0; i < entry.segmentCount && result == MA_SUCCESS; i++)
+    {
+        const tcb_cache_segment *segment = &entry.segments[i];
+        const char *text = tcb_cache_entry_text(&entry, i);
+        tcb_transcript_writer_segment(&writer, &entry, i);
+        if (onSegment != NULL)
+        {
+            onSegment(pUserData, segment->t0Ms, segment->t1Ms, text);
+        }
+        result = tcb_transcript_append(&transcript, segment->t0Ms, segment->t1Ms, text);
+    }
+
+    if (tcb_transcript_writer_close(&writer) != MA_SUCCESS)
+    {
+        result = MA_ERROR;
+    }
+    if (result == MA_SUCCESS)
+    {
+        tcb_index_add(pFilePath, &transcript);
+        tcb_catalog_add(pFilePath, TCB_RECORD_TRANSCRIBED, params.language);
+    }
+    tcb_transcript_uninit(&transcript);
+    tcb_cache_entry_uninit(&entry);
+
+    return result;
+}
+
+ma_result tcb_transcribe_file(struct whisper_context *ctx, struct whisper_state *state, struct whisper_full_params params, ma_uint32 jobs, bool cache, ma_uint32 formats, const char *pFilePath, char *pOutputPath, size_t outputPathSize, tcb_segment_proc onSegment, void *pUserData)
+{
+    ma_result result = tcb_transcript_path(pFilePath, pOutputPath, outputPathSize);
+    if (result != MA_SUCCESS)
+    {
+        return result;
+    }
+
+    tcb_stream_config streamConfig = tcb_stream_config_init(ctx, params, pOutputPath);
+    streamConfig.state = state;
+    streamConfig.workers = ma_max(jobs, 1);
+    streamConfig.cache = cache;
+    streamConfig.formats = formats;
+    streamConfig.onSegment = onSegment;
+    streamConfig.pUserData = pUserData;
+
+    /* The input is hashed as it goes by, so the finished transcript can be cached for the whole file. */
+    tcb_hash hash;
+    tcb_cache_key_init(&hash, &params, "file");
+
+    /* Recordings already in whisper's format are transcribed straight from the page cache. */
+    tcb_mapped_wav map;
+    tcb_stream stream;
+    if (tcb_mapped_wav_open(&map, pFilePath) == MA_SUCCESS)
+    {
+        streamConfig.pFrames = map.pFrames;
+        streamConfig.frameCount = map.frameCount;
+        result = tcb_stream_init(&stream, &streamConfig);
+        if (result == MA_SUCCESS)
+        {
+            tcb_stream_finish(&stream);
+            result = stream.failedChunks == 0 ? MA_SUCCESS : MA_ERROR;
+            if (result == MA_SUCCESS)
+            {
+                tcb_index_add(pFilePath, &stream.transcript);
+                if (cache)
+                {
+                    tcb_hash_update(&hash, map.pFrames, map.frameCount * sizeof(ma_float));
+                    tcb_transcribe_file_store(params, pFilePath, tcb_hash_final(&hash), &stream.segments);
+                }
+            }
+            tcb_catalog_add(pFilePath, result == MA_SUCCESS ? TCB_RECORD_TRANSCRIBED : TCB_RECORD_FAILED, params.language);
+            tcb_stream_uninit(&stream);
+        }
+        tcb_mapped_wav_close(&map);
+        return result;
+    }
+
+    /* Anything else is converted to whisper's input format while reading. */
+    tcb_reader reader;
+    result = tcb_reader_init(&reader, pFilePath);
+    if (result != MA_SUCCESS)
+    {
+        return result;
+    }
+
+    ma_float *block = malloc(DECODE_BLOCK_FRAMES * sizeof(ma_float));
+    if (block == NULL)
+    {
+        fprintf(stderr, "Failed to allocate memory for audio data.\n");
+        tcb_reader_uninit(&reader);
+        return MA_OUT_OF_MEMORY;
+    }
+
+    /* Chunks are transcribed while the rest of the file is still being decoded. */
+    streamConfig.maxBufferedFrames = (ma_uint64)TARGET_SAMPLE_RATE * STREAM_WINDOW_MS / 1000 * (streamConfig.workers + 1);
+    result = tcb_stream_init(&stream, &streamConfig);
+    if (result != MA_SUCCESS)
+    {
+        free(block);
+        tcb_reader_uninit(&reader);
+        return result;
+    }
+
+    bool complete = false;
+    while (1)
+    {
+        ma_uint64 framesRead = 0;
+        result = tcb_reader_read(&reader, block, DECODE_BLOCK_FRAMES, &framesRead);
+        tcb_hash_update(&hash, block, framesRead * sizeof(ma_float));
+        if (framesRead > 0 && tcb_stream_push(&stream, block, framesRead) != MA_SUCCESS)
+        {
+            fprintf(stderr, "Failed to push frames to transcription stream.\n");
+            break;
+        }
+
+        if (result != MA_SUCCESS || framesRead < DECODE_BLOCK_FRAMES)
+        {
+            if (result != MA_SUCCESS && result != MA_AT_END)
+            {
+                fprintf(stderr, "Failed to read audio data.\n");
+            }
+            complete = result == MA_SUCCESS || result == MA_AT_END;
+            break;
+        }
+    }
+    free(block);
+    tcb_reader_uninit(&reader);
+
+    /* A file that could not be read to the end is not transcribed, however far it got. */
+    tcb_stream_finish(&stream);
+    result = complete && stream.failedChunks == 0 ? MA_SUCCESS : MA_ERROR;
+    if (result == MA_SUCCESS)
+    {
+        tcb_index_add(pFilePath, &stream.transcript);
+        if (cache)
+        {
+            tcb_transcribe_file_store(params, pFilePath, tcb_hash_final(&hash), &stream.segments);
+        }
+    }
+    tcb_catalog_add(pFilePath, result == MA_SUCCESS ? TCB_RECORD_TRANSCRIBED : TCB_RECORD_FAILED, params.language);
+    tcb_stream_uninit(&stream);
+
+    return result;
+}
+
+tcb_stream_config tcb_stream_config_init(struct whisper_context *whisper, struct whisper_full_params params, const char *pOutputPath)
+{
+    tcb_stream_config config;
+    config.whisper = whisper;
+    config.state = NULL;
+    config.params = params;
+    config.refine = true;
+    config.cache = true;
+    config.workers = 1;
+    config.pOutputPath = pOutputPath;
+    config.formats = 1u << TCB_TRANSCRIPT_TXT;
+    config.timestamps = false;
+    config.vad = true;
+    config.maxBufferedFrames = 0;
+    config.pFrames = NULL;
+    config.frameCount = 0;
+    config.onSegment = NULL;
+    config.pUserData = NULL;
+
+    return config;
+}
+
+ma_result tcb_stream_init(tcb_stream *stream, const tcb_stream_config *config)
+{
+    memset(stream, 0, sizeof(*stream));
+    stream->whisper = config->whisper;
+    stream->params = config->params;
+    stream->refine = config->refine && config->params.strategy == WHISPER_SAMPLING_GREEDY;
+    stream->cache = config->cache;
+    stream->vadEnabled = config->vad;
+    stream->onSegment = config->onSegment;
+    stream->pUserData = config->pUserData;
+    stream->windowFrames = (ma_uint64)TARGET_SAMPLE_RATE * STREAM_WINDOW_MS / 1000;
+    stream->splitSearchFrames = (ma_uint64)TARGET_SAMPLE_RATE * STREAM_SPLIT_SEARCH_MS / 1000;
+    stream->maxBufferedFrames = config->maxBufferedFrames;
+    stream->bufferCapacity = ma_max(stream->windowFrames * 2, stream->maxBufferedFrames);
+
+    /* A complete input is read in place, nothing is ever pushed. */
+    stream->source = config->pFrames;
+    if (stream->source != NULL)
+    {
+        stream->bufferFrames = config->frameCount;
+        stream->bufferCapacity = 0;
+        stream->finished = true;
+    }
+
+    if (tcb_transcript_writer_open(&stream->writer, config->pOutputPath, config->formats, config->timestamps) != MA_SUCCESS)
+    {
+        return MA_ERROR;
+    }
+
+    stream->buffer = stream->source == NULL ? malloc(stream->bufferCapacity * sizeof(ma_float)) : NULL;
+    stream->workers = calloc(ma_max(config->workers, 1), sizeof(tcb_stream_worker));
+    if ((stream->source == NULL && !stream->buffer) || !stream->workers)
+    {
+        fprintf(stderr, "Failed to allocate memory for transcription stream.\n");
+        tcb_stream_uninit(stream);
+        return MA_OUT_OF_MEMORY;
+    }
+
+    for (ma_uint32 i = 0; i < ma_max(config->workers, 1); i++)
+    {
+        tcb_stream_worker *worker = &stream->workers[i];
+        worker->stream = stream;
+        stream->workerCount++;
+
+        /* One worker may borrow the caller's state, every other one needs its own. */
+        worker->state = config->state;
+        if (config->workers > 1)
+        {
+            worker->state = whisper_init_state(config->whisper);
+            worker->ownsState = true;
+        }
+
+        worker->window = malloc(stream->windowFrames * sizeof(ma_float));
+        if (!worker->window ||
+            (worker->ownsState && worker->state == NULL) ||
+            (stream->vadEnabled && tcb_vad_init(&worker->vad, stream->windowFrames) != MA_SUCCESS))
+        {
+            fprintf(stderr, "Failed to initialize transcription worker %u.\n", i);
+            tcb_stream_uninit(stream);
+            return MA_OUT_OF_MEMORY;
+        }
+    }
+
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_mutex_init(&stream->outputLock, NULL);
+    pthread_cond_init(&stream->cond, NULL);
+    pthread_cond_init(&stream->spaceCond, NULL);
+    pthread_cond_init(&stream->commitCond, NULL);
+    pthread_cond_init(&stream->refineCond, NULL);
+    for (ma_uint32 i = 0; i < stream->workerCount; i++)
+    {
+        if (pthread_create(&stream->workers[i].thread, NULL, tcb_stream_thread, &stream->workers[i]) == 0)
+        {
+            stream->threadCount++;
+        }
+        else
+        {
+            fprintf(stderr, "Failed to start transcription thread.\n");
+            tcb_stream_finish(stream);
+            tcb_stream_uninit(stream);
+            return MA_ERROR;
+        }
+    }
+
+    return MA_SUCCESS;
+}
+
+ma_result tcb_stream_push(tcb_stream *stream, const ma_float *frames, ma_uint64 frameCount)
+{
+    pthread_mutex_lock(&stream->lock);
+
+    /* A bounded stream makes the producer wait instead of buffering the whole input. */
+    while (stream->maxBufferedFrames > 0 &&
+           stream->bufferFrames > 0 &&
+           stream->bufferFrames + frameCount > stream->maxBufferedFrames)
+    {
+        pthread_cond_wait(&stream->spaceCond, &stream->lock);
+    }
+
+    if (stream->bufferFrames + frameCount > stream->bufferCapacity)
+    {
+        /* The workers fell behind real time; keep everything rather than drop speech. */
+        ma_uint64 capacity = stream->bufferCapacity;
+        while (stream->bufferFrames + frameCount > capacity)
+        {
+            capacity *= 2;
+        }
+
+        ma_float *buffer = realloc(stream->buffer, capacity * sizeof(ma_float));
+        stream->heapCalls++;
+        if (buffer == NULL)
+        {
+            pthread_mutex_unlock(&stream->lock);
+            return MA_OUT_OF_MEMORY;
+        }
+        stream->buffer = buffer;
+        stream->bufferCapacity = capacity;
+    }
+
+    memcpy(stream->buffer + stream->bufferFrames, frames, frameCount * sizeof(ma_float));
+    stream->bufferFrames += frameCount;
+    if (stream->bufferFrames >= stream->windowFrames)
+    {
+        pthread_cond_signal(&stream->cond);
+    }
+    pthread_mutex_unlock(&stream->lock);
+
+    return MA_SUCCESS;
+}
+
+/* Cuts a full window at its quietest block near the end, so chunks rarely split a word. */
+static ma_uint64 tcb_stream_split_point(const tcb_stream *stream, const ma_float *pFrames)
+{
+    const ma_uint64 blockFrames = (ma_uint64)TARGET_SAMPLE_RATE * VAD_FRAME_MS / 1000;
+    ma_uint64 split = stream->windowFrames;
+    double quietest = -1.0;
+    for (ma_uint64 start = stream->windowFrames - stream->splitSearchFrames; start + blockFrames <= stream->windowFrames; start += blockFrames)
+    {
+        double energy = 0.0;
+        for (ma_uint64 i = start; i < start + blockFrames; i++)
+        {
+            energy += (double)pFrames[i] * pFrames[i];
+        }
+
+        if (quietest < 0.0 || energy < quietest)
+        {
+            quietest = energy;
+            split = start + blockFrames / 2;
+        }
+    }
+
+    return split;
+}
+
+/* Segment i of pResult, moved to t0 and t1 in the input, becomes the next segment of the transcript. */
+static ma_result tcb_stream_emit(tcb_stream *stream, const tcb_cache_entry *pResult, size_t i, ma_int64 t0, ma_int64 t1, size_t *pSegment)
+{
+    /* Kept with their timestamps and tokens for the search index, the cache and refinement, whatever the files show. */
+    const char *text = tcb_cache_entry_text(pResult, i);
+    pthread_mutex_lock(&stream->outputLock);
+    ma_result result = tcb_cache_entry_copy(&stream->segments, pResult, i, t0, t1);
+    if (result == MA_SUCCESS)
+    {
+        *pSegment = stream->segments.segmentCount - 1;
+        tcb_transcript_writer_segment(&stream->writer, &stream->segments, *pSegment);
+        result = tcb_transcript_append(&stream->transcript, t0, t1, text);
+    }
+    pthread_mutex_unlock(&stream->outputLock);
+    if (result != MA_SUCCESS)
+    {
+        fprintf(stderr, "Failed to keep segment for the search index.\n");
+    }
+
+    if (stream->onSegment != NULL)
+    {
+        stream->onSegment(stream->pUserData, t0, t1, text);
+    }
+
+    return result;
+}
+
+/* Runs whisper on pFrames into pResult, times relative to pFrames, and caches the result under key. */
+static ma_result tcb_stream_decode(tcb_stream *stream, struct whisper_state *state, struct whisper_full_params params, const ma_float *pFrames, ma_uint64 frameCount, ma_uint64 key, tcb_cache_entry *pResult)
+{
+    tcb_cache_entry_reset(pResult);
+    if (tcb_whisper_full(stream->whisper, state, params, pFrames, (int)frameCount) != 0)
+    {
+        return MA_ERROR;
+    }
+
+    const int segments = tcb_whisper_n_segments(stream->whisper, state);
+    for (int i = 0; i < segments; i++)
+    {
+        ma_int64 t0, t1;
+        float entropy;
+        const char *text = tcb_whisper_segment(stream->whisper, state, i, &t0, &t1);
+        float logprob = tcb_whisper_segment_logprob(stream->whisper, state, i, &entropy);
+        if (tcb_cache_entry_append(pResult, t0, t1, logprob, entropy, text, strlen(text)) != MA_SUCCESS ||
+            tcb_whisper_segment_tokens(stream->whisper, state, i, pResult) != MA_SUCCESS)
+        {
+            return MA_OUT_OF_MEMORY;
+        }
+    }
+
+    if (stream->cache)
+    {
+        tcb_cache_store(key, pResult);
+    }
+    return MA_SUCCESS;
+}
+
+/* Decodes a job again with beam search into pResult. True if it beats the greedy one. */
+static bool tcb_stream_refine_text(tcb_stream *stream, struct whisper_state **pState, struct whisper_full_params params, const tcb_refine_job *job, tcb_cache_entry *pResult)
+{
+    ma_uint64 key = stream->cache ? tcb_cache_key(&params, "refine", job->frames, job->frameCount) : 0;
+    if (!stream->cache || tcb_cache_load(key, pResult) != MA_SUCCESS)
+    {
+        /* The thread's own state, and the memory it takes, only exists once a result is not cached. */
+        if (*pState == NULL && (*pState = whisper_init_state(stream->whisper)) == NULL)
+        {
+            fprintf(stderr, "Failed to initialize whisper state for refinement.\n");
+            return false;
+        }
+
+        if (tcb_stream_decode(stream, *pState, params, job->frames, job->frameCount, key, pResult) != MA_SUCCESS)
+        {
+            return false;
+        }
+    }
+
+    const size_t segments = pResult->segmentCount;
+    float logprob = 0.0f;
+    bool repetitive = false;
+    for (size_t i = 0; i < segments; i++)
+    {
+        logprob += pResult->segments[i].logprob;
+        repetitive = repetitive || pResult->segments[i].entropy < REFINE_ENTROPY_THRESHOLD;
+    }
+
+    /* A segment that repeated itself is replaced by anything that does not, any other only by a more likely one. */
+    return segments > 0 && !repetitive && (job->repetitive || logprob / segments > job->logprob);
+}
+
+static void *tcb_stream_refine_thread(void *arg)
+{
+    tcb_stream *stream = (tcb_stream *)arg;
+    struct whisper_state *state = NULL;
+    tcb_cache_entry result;
+    memset(&result, 0, sizeof(result));
+
+    /* Each segment is decoded on its own, the text around it may be the part that went wrong. */
+    struct whisper_full_params params = stream->params;
+    params.strategy = WHISPER_SAMPLING_BEAM_SEARCH;
+    params.beam_search.beam_size = WHISPER_BEAM_SIZE;
+    params.single_segment = true;
+    params.no_context = true;
+
+    bool dirty = false;
+    pthread_mutex_lock(&stream->lock);
+    while (1)
+    {
+        while (stream->refineHead == NULL && !stream->refineFinished)
+        {
+            pthread_cond_wait(&stream->refineCond, &stream->lock);
+        }
+
+        tcb_refine_job *job = stream->refineHead;
+        if (job == NULL)
+        {
+            break;
+        }
+        stream->refineHead = job->next;
+        stream->refineTail = stream->refineHead != NULL ? stream->refineTail : NULL;
+        pthread_mutex_unlock(&stream->lock);
+
+        if (tcb_stream_refine_text(stream, &state, params, job, &result))
+        {
+            pthread_mutex_lock(&stream->outputLock);
+            if (tcb_cache_entry_replace(&stream->segments, job->segment, &result) == MA_SUCCESS &&
+                tcb_transcript_replace(&stream->transcript, job->segment, tcb_cache_entry_text(&stream->segments, job->segment)) == MA_SUCCESS)
+            {
+                tcb_transcript_writer_refined(&stream->writer, &stream->segments, job->segment);
+                dirty = true;
+            }
+            pthread_mutex_unlock(&stream->outputLock);
+        }
+        free(job);
+
+        /* The file is rewritten once the queue runs dry, not for every segment. */
+        pthread_mutex_lock(&stream->lock);
+        if (dirty && stream->refineHead == NULL)
+        {
+            pthread_mutex_unlock(&stream->lock);
+            pthread_mutex_lock(&stream->outputLock);
+            if (tcb_transcript_writer_rewrite(&stream->writer, &stream->segments) != MA_SUCCESS)
+            {
+                fprintf(stderr, "Failed to rewrite transcription file.\n");
+            }
+            pthread_mutex_unlock(&stream->outputLock);
+            dirty = false;
+            pthread_mutex_lock(&stream->lock);
+        }
+    }
+    pthread_mutex_unlock(&stream->lock);
+
+    tcb_cache_entry_uninit(&result);
+    if (state != NULL)
+    {
+        whisper_free_state(state);
+    }
+
+    return NULL;
+}
+
+/* Copies the audio of a segment, t0Ms and t1Ms are relative to pFrames, and hands it to the refinement thread. */
+static void tcb_stream_queue_refine(tcb_stream *stream, size_t segment, float logprob, float entropy, const ma_float *pFrames, ma_uint64 frameCount, ma_int64 t0Ms, ma_int64 t1Ms)
+{
+    const ma_uint64 padFrames = (ma_uint64)TARGET_SAMPLE_RATE * REFINE_PAD_MS / 1000;
+    ma_uint64 start = (ma_uint64)ma_max(t0Ms, 0) * TARGET_SAMPLE_RATE / 1000;
+    ma_uint64 end = ma_min((ma_uint64)ma_max(t1Ms, 0) * TARGET_SAMPLE_RATE / 1000 + padFrames, frameCount);
+    start = ma_min(start > padFrames ? start - padFrames : 0, frameCount);
+    if (end <= start)
+    {
+        return;
+    }
+
+    /* whisper ignores inputs under a second, so short segments are padded with silence. */
+    ma_uint64 jobFrames = ma_max(end - start, TARGET_SAMPLE_RATE + TARGET_SAMPLE_RATE / 10);
+    tcb_refine_job *job = malloc(sizeof(tcb_refine_job) + jobFrames * sizeof(ma_float));
+    if (job == NULL)
+    {
+        return;
+    }
+    job->next = NULL;
+    job->segment = segment;
+    job->logprob = logprob;
+    job->repetitive = entropy < REFINE_ENTROPY_THRESHOLD;
+    job->frameCount = jobFrames;
+    memcpy(job->frames, pFrames + start, (end - start) * sizeof(ma_float));
+    memset(job->frames + (end - start), 0, (jobFrames - (end - start)) * sizeof(ma_float));
+
+    pthread_mutex_lock(&stream->lock);
+    if (stream->refineTail != NULL)
+    {
+        stream->refineTail->next = job;
+    }
+    else
+    {
+        stream->refineHead = job;
+    }
+    stream->refineTail = job;
+
+    /* Most audio is clean, the thread and its whisper state only exist once something needs them. */
+    if (!stream->refineStarted)
+    {
+        if (pthread_create(&stream->refineThread, NULL, tcb_stream_refine_thread, stream) == 0)
+        {
+            stream->refineStarted = true;
+        }
+        else
+        {
+            fprintf(stderr, "Failed to start refinement thread.\n");
+        }
+    }
+    pthread_cond_signal(&stream->refineCond);
+    pthread_mutex_unlock(&stream->lock);
+}
+
+void *tcb_stream_thread(void *arg)
+{
+    tcb_stream_worker *worker = (tcb_stream_worker *)arg;
+    tcb_stream *stream = worker->stream;
+    assert(stream != NULL);
+
+    pthread_mutex_lock(&stream->lock);
+    while (1)
+    {
+        while (!stream->finished && stream->bufferFrames < stream->windowFrames)
+        {
+            pthread_cond_wait(&stream->cond, &stream->lock);
+        }
+
+        if (stream->bufferFrames == 0)
+        {
+            break;
+        }
+
+        /* Take the next chunk off the front of the input. A pushed buffer moves, so it is copied out. */
+        const ma_float *pFrames = stream->source != NULL ? stream->source + stream->bufferStart : stream->buffer;
+        ma_uint64 frameCount = stream->bufferFrames <= stream->windowFrames ? stream->bufferFrames : tcb_stream_split_point(stream, pFrames);
+        ma_uint64 chunk = stream->nextChunk++;
+        ma_int64 chunkStartMs = (ma_int64)(stream->bufferStart * 1000 / TARGET_SAMPLE_RATE);
+        if (stream->source == NULL)
+        {
+            memcpy(worker->window, stream->buffer, frameCount * sizeof(ma_float));
+            memmove(stream->buffer, stream->buffer + frameCount, (stream->bufferFrames - frameCount) * sizeof(ma_float));
+            pFrames = worker->window;
+        }
+        stream->bufferFrames -= frameCount;
+        stream->bufferStart += frameCount;
+        pthread_cond_signal(&stream->spaceCond);
+        if (stream->bufferFrames >= stream->windowFrames || (stream->finished && stream->bufferFrames > 0))
+        {
+            pthread_cond_signal(&stream->cond);
+        }
+        pthread_mutex_unlock(&stream->lock);
+
+        ma_uint64 speechFrames = frameCount;
+        if (stream->vadEnabled)
+        {
+            /* One speech span is passed as is, only several have to be packed together. */
+            speechFrames = tcb_vad_detect(&worker->vad, pFrames, frameCount);
+            if (worker->vad.spanCount == 1)
+            {
+                pFrames += worker->vad.spans[0].start;
+            }
+            else if (worker->vad.spanCount > 1)
+            {
+                tcb_vad_pack(&worker->vad, pFrames, worker->window);
+                pFrames = worker->window;
+            }
+        }
+
+        /* A chunk of pure silence is skipped, whisper would only hallucinate on it. The same speech seen before is not decoded again. */
+        bool failed = false;
+        tcb_cache_entry *result = &worker->result;
+        tcb_cache_entry_reset(result);
+        if (speechFrames > 0)
+        {
+            ma_uint64 key = stream->cache ? tcb_cache_key(&stream->params, "chunk", pFrames, speechFrames) : 0;
+            if (!stream->cache || tcb_cache_load(key, result) != MA_SUCCESS)
+            {
+                failed = tcb_stream_decode(stream, worker->state, stream->params, pFrames, speechFrames, key, result) != MA_SUCCESS;
+            }
+        }
+        const size_t segments = failed ? 0 : result->segmentCount;
+
+        /* Segments are written in chunk order whichever worker finishes first. */
+        pthread_mutex_lock(&stream->lock);
+        while (stream->committedChunks != chunk)
+        {
+            pthread_cond_wait(&stream->commitCond, &stream->lock);
+        }
+        pthread_mutex_unlock(&stream->lock);
+
+        if (failed)
+        {
+            fprintf(stderr, "Failed to process audio chunk at %lld ms\n", (long long)chunkStartMs);
+        }
+
+        for (size_t i = 0; i < segments; i++)
+        {
+            const tcb_cache_segment *cached = &result->segments[i];
+            ma_int64 t0 = cached->t0Ms;
+            ma_int64 t1 = cached->t1Ms;
+            if (stream->vadEnabled)
+            {
+                t0 = tcb_vad_map_ms(&worker->vad, t0);
+                t1 = tcb_vad_map_ms(&worker->vad, t1);
+            }
+
+            size_t segment;
+            if (tcb_stream_emit(stream, result, i, chunkStartMs + t0, chunkStartMs + t1, &segment) == MA_SUCCESS &&
+                stream->refine &&
+                (cached->logprob < REFINE_LOGPROB_THRESHOLD || cached->entropy < REFINE_ENTROPY_THRESHOLD))
+            {
+                tcb_stream_queue_refine(stream, segment, cached->logprob, cached->entropy, pFrames, speechFrames, cached->t0Ms, cached->t1Ms);
+            }
+        }
+        pthread_mutex_lock(&stream->outputLock);
+        tcb_transcript_writer_flush(&stream->writer);
+        pthread_mutex_unlock(&stream->outputLock);
+
+        pthread_mutex_lock(&stream->lock);
+        stream->inputFrames += frameCount;
+        stream->speechFrames += speechFrames;
+        stream->failedChunks += failed ? 1 : 0;
+        stream->committedChunks++;
+        pthread_cond_broadcast(&stream->commitCond);
+    }
+    pthread_cond_broadcast(&stream->cond);
+    pthread_mutex_unlock(&stream->lock);
+
+    return NULL;
+}
+
+void tcb_stream_finish(tcb_stream *stream)
+{
+    pthread_mutex_lock(&stream->lock);
+    stream->finished = true;
+    pthread_cond_broadcast(&stream->cond);
+    pthread_mutex_unlock(&stream->lock);
+
+    for (ma_uint32 i = 0; i < stream->threadCount; i++)
+    {
+        pthread_join(stream->workers[i].thread, NULL);
+    }
+
+    /* The transcript is final once every low-confidence segment has been refined. */
+    pthread_mutex_lock(&stream->lock);
+    stream->refineFinished = true;
+    pthread_cond_broadcast(&stream->refineCond);
+    pthread_mutex_unlock(&stream->lock);
+    if (stream->refineStarted)
+    {
+        pthread_join(stream->refineThread, NULL);
+    }
+
+    pthread_mutex_destroy(&stream->lock);
+    pthread_mutex_destroy(&stream->outputLock);
+    pthread_cond_destroy(&stream->cond);
+    pthread_cond_destroy(&stream->spaceCond);
+    pthread_cond_destroy(&stream->commitCond);
+    pthread_cond_destroy(&stream->refineCond);
+}
+
+void tcb_stream_uninit(tcb_stream *stream)
+{
+    tcb_transcript_writer_close(&stream->writer);
+
+    for (ma_uint32 i = 0; stream->workers != NULL && i < stream->workerCount; i++)
+    {
+        tcb_stream_worker *worker = &stream->workers[i];
+        if (worker->ownsState && worker->state != NULL)
+        {
+            whisper_free_state(worker->state);
+        }
+        free(worker->window);
+        tcb_vad_uninit(&worker->vad);
+        tcb_cache_entry_uninit(&worker->result);
+    }
+    free(stream->workers);
+    free(stream->buffer);
+    stream->workers = NULL;
+    stream->buffer = NULL;
+    while (stream->refineHead != NULL)
+    {
+        tcb_refine_job *job = stream->refineHead;
+        stream->refineHead = job->next;
+        free(job);
+    }
+    stream->refineTail = NULL;
+    tcb_transcript_uninit(&stream->transcript);
+    tcb_cache_entry_uninit(&stream->segments);
+}
+
+static volatile sig_atomic_t g_recordStop = 0;
+
+static void tcb_record_on_signal(int signal)
+{
+    g_recordStop = 1;
+    (void)signal;
+}
+
+/* Returns on Enter, end of input, SIGINT or SIGTERM, so the recording is always closed cleanly. */
+void tcb_wait_for_stop(void)
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = tcb_record_on_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    struct pollfd pfd = {.fd = STDIN_FILENO, .events = POLLIN};
+    while (!g_recordStop)
+    {
+        if (poll(&pfd, 1, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+
+        char c;
+        ssize_t n = read(STDIN_FILENO, &c, 1);
+        if (n == 0)
+        {
+            /* No terminal, as when run from a service manager: only a signal stops the recording. */
+            while (!g_recordStop)
+            {
+                poll(NULL, 0, 200);
+            }
+        }
+        else if ((n < 0 && errno != EINTR) || (n == 1 && c == '\n'))
+        {
+            break;
+        }
+    }
+
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+}
+
+void tcb_record_file_closed(void *pUserData, ma_uint32 track, const char *pFilePath)
+{
+    tcb_path_list *list = (tcb_path_list *)pUserData;
+    if (track > 0)
+    {
+        printf("Track saved to: %s\n", pFilePath);
+        return;
+    }
+
+    tcb_catalog_add(pFilePath, TCB_RECORD_RECORDED, NULL);
+    printf("Audio file saved to: %s\n", pFilePath);
+    if (list->count == list->capacity)
+    {
+        size_t capacity = list->capacity ? list->capacity * 2 : 16;
+        char(*paths)[512] = realloc(list->paths, capacity * sizeof(*paths));
+        if (paths == NULL)
+        {
+            return;
+        }
+        list->paths = paths;
+        list->capacity = capacity;
+    }
+    snprintf(list->paths[list->count++], sizeof(list->paths[0]), "%s", pFilePath);
+}
+
+int main(int argc, char **argv)
+{
+    ensure_record_folder();
+
+    ma_context context;
+    if (ma_context_init(NULL, 0, NULL, &context) != MA_SUCCESS)
+    {
+        fprintf(stderr, "Failed to initialize context.\n");
+        return -1;
+    }
+
+    if (argc < 2)
+    {
+        printf("Usage: %s <command> [options]\n", argv[0]);
+        printf("Commands:\n");
+        printf("    list-devices            List available devices\n");
         printf("    list-records            List all recorded files\n");
-        printf("    record <dev1> <dev2>   Record using specified devices\n");
+        printf("           --sort <date|duration|size|name>  Order of the list (default: date)\n");
+        printf("           --reverse       Reverse the order\n");
+        printf("           --since <YYYY-MM-DD>  Only records from this day on\n");
+        printf("           --until <YYYY-MM-DD>  Only records up to this day\n");
+        printf("           --min-duration <seconds>  Only records at least this long\n");
+        printf("           --max-duration <seconds>  Only records at most this long\n");
+        printf("           --status <recorded|transcribed|failed>  Only records with this status\n");
+        printf("    record <dev1> [dev2 ...]   Record using specified devices\n");
         printf("           --record-name <name>   Name of the recording\n");
         printf("           --language <language>  Language of the recording\n");
         printf("           --use-gpu       Use gpu inference \n");
         printf("           --no-transcribe   Do not transcribe after recording\n");
+        printf("           --stream        Transcribe while recording\n");
+        printf("           --output <srt,vtt,json>  Also write the transcript in these formats\n");
+        printf("           --gains <g1,g2,...>  Gain applied to each device\n");
+        printf("           --wake-ms <ms>  Audio captured before the mixer wakes up\n");
+        printf("           --profile <low-latency|throughput>  Preset for the options below\n");
+        printf("           --period-ms <ms>  Capture period of each device, 0 for the backend default\n");
+        printf("           --periods <n>   Capture periods of each device, 0 for the backend default\n");
+        printf("           --ring-ms <ms>  Audio each device can buffer before it overflows (default: %d)\n", CAPTURE_RING_MS);
+        printf("           --block-ms <ms>  Largest block the mixer handles at once, 0 for the whole ring\n");
+        printf("           --stats [seconds]  Print capture stats periodically and save them as JSON\n");
+        printf("           --no-drift-correction  Do not lock devices to the clock of the first one\n");
+        printf("           --format <wav|flac|opus>  Audio format of the recording (default: wav)\n");
+        printf("           --tracks <multichannel|separate>  Also save every device as its own track\n");
+        printf("           --segment <seconds>  Split the recording into files of this length\n");
+        printf("           --rt-priority <1-99>  Run the mixer with this SCHED_FIFO priority\n");
+        printf("           --mixer-cpu <n>  Pin the mixer thread to this CPU\n");
         printf("    transcribe <file>       Transcribe a specific file\n");
         printf("           --language <language>  Language of the recording\n");
         printf("           --use-gpu       Use gpu inference \n");
+        printf("           --remote        Send the file to a running tcb serve\n");
+        printf("           --beam          Decode everything with beam search instead of refining uncertain segments\n");
+        printf("           --no-cache      Transcribe again even if the audio was transcribed before\n");
+        printf("           --output <srt,vtt,json>  Also write the transcript in these formats\n");
+        printf("           --socket <path>  Socket of the server\n");
+        printf("           --jobs <n>      Chunks transcribed at the same time, 0 for physical cores / threads (default: 1)\n");
+        printf("           --threads <n>   Threads per chunk (default: physical cores / jobs)\n");
+        printf("    transcribe-all          Transcribe every record without a transcript\n");
+        printf("           --language <language>  Language of the recordings\n");
+        printf("           --use-gpu       Use gpu inference \n");
+        printf("           --jobs <n>      Files transcribed at the same time (default: physical cores / %d)\n", WHISPER_JOB_THREADS);
+        printf("           --threads <n>   Threads per file (default: physical cores / jobs)\n");
+        printf("    search <words>          Find recordings whose transcript has all the words\n");
+        printf("           --limit <n>     Most segments shown (default: %d)\n", INDEX_SEARCH_LIMIT);
+        printf("    index                   Add transcripts written before the search index existed\n");
+        printf("    serve                   Keep the model loaded and transcribe files sent with --remote\n");
+        printf("           --use-gpu       Use gpu inference \n");
+        printf("           --socket <path>  Socket to listen on\n");
+        printf("    bench-mix [sources] [frames]  Benchmark the mix kernels\n");
+        printf("    bench                   Benchmark capture, mix, encode and transcription\n");
+        printf("           --sources <n>   Synthetic sources replayed through the mixer (default: 2)\n");
+        printf("           --seconds <n>   Audio replayed per source (default: %d)\n", BENCH_SECONDS);
+        printf("           --period-ms <ms>  Frames delivered per capture callback (default: %d)\n", BENCH_PERIOD_MS);
+        printf("           --wake-ms <ms>  Audio captured before the mixer wakes up\n");
+        printf("           --format <wav|flac|opus>  Audio format written by the writer (default: wav)\n");
+        printf("           --tracks <multichannel|separate>  Also write every source as its own track\n");
+        printf("           --clip <file>   Also time the transcription of this file\n");
+        printf("           --language <language>  Language of the clip (default: en)\n");
+        printf("           --use-gpu       Use gpu inference \n");
+        printf("           --jobs <n>      Chunks transcribed at the same time (default: 1)\n");
+        printf("           --json <file>   Save the results as JSON\n");
+        printf("    load-test               Count capture xruns under CPU load, with and without a real-time mixer\n");
+        printf("           --sources <n>   Synthetic sources captured in real time (default: 2)\n");
+        printf("           --seconds <n>   Length of each run (default: %d)\n", LOAD_TEST_SECONDS);
+        printf("           --period-ms <ms>  Frames delivered per capture callback (default: %d)\n", BENCH_PERIOD_MS);
+        printf("           --load <n>      Busy threads competing for the CPUs (default: one per CPU)\n");
+        printf("           --rt-priority <1-99>  SCHED_FIFO priority of the real-time run (default: %d)\n", MIXER_RT_PRIORITY);
+        printf("           --mixer-cpu <n>  Pin the mixer to this CPU in the real-time run\n");
         return 0;
     }
 
-    if (strcmp(argv[1], "list-devices") == 0)
-    {
-        list_devices(&context);
-    }
-    else if (strcmp(argv[1], "list-records") == 0)
-    {
-        list_records();
+    if (strcmp(argv[1], "list-devices") == 0)
+    {
+        list_devices(&context);
+    }
+    else if (strcmp(argv[1], "list-records") == 0)
+    {
+        tcb_catalog_filter filter = tcb_catalog_filter_init();
+        for (int i = 2; i < argc; i++)
+        {
+            if (strcmp(argv[i], "--sort") == 0 && i + 1 < argc)
+            {
+                if (strcmp(argv[i + 1], "date") == 0)
+                {
+                    filter.sort = TCB_CATALOG_SORT_DATE;
+                }
+                else if (strcmp(argv[i + 1], "duration") == 0)
+                {
+                    filter.sort = TCB_CATALOG_SORT_DURATION;
+                }
+                else if (strcmp(argv[i + 1], "size") == 0)
+                {
+                    filter.sort = TCB_CATALOG_SORT_SIZE;
+                }
+                else if (strcmp(argv[i + 1], "name") == 0)
+                {
+                    filter.sort = TCB_CATALOG_SORT_NAME;
+                }
+                else
+                {
+                    fprintf(stderr, "Unknown sort order: %s\n", argv[i + 1]);
+                    return -1;
+                }
+                continue;
+            }
+
+            if (strcmp(argv[i], "--reverse") == 0)
+            {
+                filter.reverse = true;
+                continue;
+            }
+
+            if ((strcmp(argv[i], "--since") == 0 || strcmp(argv[i], "--until") == 0) && i + 1 < argc)
+            {
+                struct tm date = {0};
+                if (sscanf(argv[i + 1], "%d-%d-%d", &date.tm_year, &date.tm_mon, &date.tm_mday) != 3)
+                {
+                    fprintf(stderr, "Invalid date, expected YYYY-MM-DD: %s\n", argv[i + 1]);
+                    return -1;
+                }
+                date.tm_year -= 1900;
+                date.tm_mon -= 1;
+                date.tm_isdst = -1;
+
+                /* Both ends are whole days, --until includes the day it names. */
+                if (strcmp(argv[i], "--since") == 0)
+                {
+                    filter.since = mktime(&date);
+                }
+                else
+                {
+                    date.tm_mday += 1;
+                    filter.until = mktime(&date);
+                }
+                continue;
+            }
+
+            if (strcmp(argv[i], "--min-duration") == 0 && i + 1 < argc)
+            {
+                filter.minDurationMs = (ma_uint64)(ma_max(0.0, atof(argv[i + 1])) * 1000);
+                continue;
+            }
+
+            if (strcmp(argv[i], "--max-duration") == 0 && i + 1 < argc)
+            {
+                filter.maxDurationMs = (ma_uint64)(ma_max(0.0, atof(argv[i + 1])) * 1000);
+                continue;
+            }
+
+            if (strcmp(argv[i], "--status") == 0 && i + 1 < argc)
+            {
+                if (strcmp(argv[i + 1], "recorded") == 0)
+                {
+                    filter.status = TCB_RECORD_RECORDED;
+                }
+                else if (strcmp(argv[i + 1], "transcribed") == 0)
+                {
+                    filter.status = TCB_RECORD_TRANSCRIBED;
+                }
+                else if (strcmp(argv[i + 1], "failed") == 0)
+                {
+                    filter.status = TCB_RECORD_FAILED;
+                }
+                else
+                {
+                    fprintf(stderr, "Unknown status: %s\n", argv[i + 1]);
+                    return -1;
+                }
+                continue;
+            }
+        }
+
+        if (tcb_catalog_list(&filter) != 0)
+        {
+            return 1;
+        }
+    }
+    else if (strcmp(argv[1], "search") == 0)
+    {
+        char query[1024] = "";
+        ma_uint32 limit = INDEX_SEARCH_LIMIT;
+        for (int i = 2; i < argc; i++)
+        {
+            if (strcmp(argv[i], "--limit") == 0 && i + 1 < argc)
+            {
+                limit = (ma_uint32)ma_max(1, atoi(argv[i + 1]));
+                i++;
+                continue;
+            }
+
+            size_t length = strlen(query);
+            snprintf(query + length, sizeof(query) - length, "%s%s", length > 0 ? " " : "", argv[i]);
+        }
+
+        if (tcb_index_search(query, limit) != 0)
+        {
+            return 1;
+        }
+    }
+    else if (strcmp(argv[1], "index") == 0)
+    {
+        if (tcb_index_missing() != 0)
+        {
+            return 1;
+        }
+    }
+    else if (strcmp(argv[1], "bench-mix") == 0)
+    {
+        ma_uint32 sourceCount = argc > 2 ? (ma_uint32)atoi(argv[2]) : 4;
+        ma_uint64 frameCount = argc > 3 ? (ma_uint64)atoll(argv[3]) : 16000;
+        if (sourceCount == 0 || frameCount == 0)
+        {
+            fprintf(stderr, "Specify a positive number of sources and frames.\n");
+            return -1;
+        }
+
+        if (tcb_mix_bench(sourceCount, frameCount, 2000) != 0)
+        {
+            return 1;
+        }
+    }
+    else if (strcmp(argv[1], "bench") == 0)
+    {
+        tcb_bench_config benchConfig = tcb_bench_config_init();
+        for (int i = 2; i < argc; i++)
+        {
+            if (strcmp(argv[i], "--sources") == 0 && i + 1 < argc)
+            {
+                benchConfig.sourceCount = (ma_uint32)ma_max(0, atoi(argv[i + 1]));
+                continue;
+            }
+
+            if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+            {
+                benchConfig.seconds = (ma_uint32)ma_max(0, atoi(argv[i + 1]));
+                continue;
+            }
+
+            if (strcmp(argv[i], "--period-ms") == 0 && i + 1 < argc)
+            {
+                benchConfig.periodMs = (ma_uint32)ma_max(1, atoi(argv[i + 1]));
+                continue;
+            }
+
+            if (strcmp(argv[i], "--wake-ms") == 0 && i + 1 < argc)
+            {
+                benchConfig.wakeThresholdMs = (ma_uint32)ma_max(1, atoi(argv[i + 1]));
+                continue;
+            }
+
+            if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+            {
+                if (strcmp(argv[i + 1], "wav") == 0)
+                {
+                    benchConfig.format = TCB_FORMAT_WAV;
+                }
+                else if (strcmp(argv[i + 1], "flac") == 0)
+                {
+                    benchConfig.format = TCB_FORMAT_FLAC;
+                }
+                else if (strcmp(argv[i + 1], "opus") == 0)
+                {
+                    benchConfig.format = TCB_FORMAT_OPUS;
+                }
+                else
+                {
+                    fprintf(stderr, "Unknown format: %s\n", argv[i + 1]);
+                    return -1;
+                }
+                continue;
+            }
+
+            if (strcmp(argv[i], "--tracks") == 0 && i + 1 < argc)
+            {
+                if (strcmp(argv[i + 1], "multichannel") == 0)
+                {
+                    benchConfig.trackMode = TCB_TRACKS_MULTICHANNEL;
+                }
+                else if (strcmp(argv[i + 1], "separate") == 0)
+                {
+                    benchConfig.trackMode = TCB_TRACKS_SEPARATE;
+                }
+                else
+                {
+                    fprintf(stderr, "Unknown track mode: %s\n", argv[i + 1]);
+                    return -1;
+                }
+                continue;
+            }
+
+            if (strcmp(argv[i], "--clip") == 0 && i + 1 < argc)
+            {
+                benchConfig.pClipPath = argv[i + 1];
+                continue;
+            }
+
+            if (strcmp(argv[i], "--language") == 0 && i + 1 < argc)
+            {
+                benchConfig.language = argv[i + 1];
+                continue;
+            }
+
+            if (strcmp(argv[i], "--use-gpu") == 0)
+            {
+                benchConfig.useGpu = true;
+                continue;
+            }
+
+            if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+            {
+                benchConfig.jobs = (ma_uint32)ma_max(1, atoi(argv[i + 1]));
+                continue;
+            }
+
+            if (strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            {
+                benchConfig.pJsonPath = argv[i + 1];
+                continue;
+            }
+        }
+
+        if (tcb_bench(&benchConfig) != 0)
+        {
+            return 1;
+        }
+    }
+    else if (strcmp(argv[1], "load-test") == 0)
+    {
+        tcb_load_config loadConfig = tcb_load_config_init();
+        for (int i = 2; i < argc; i++)
+        {
+            if (strcmp(argv[i], "--sources") == 0 && i + 1 < argc)
+            {
+                loadConfig.sourceCount = (ma_uint32)ma_max(0, atoi(argv[i + 1]));
+                continue;
+            }
+
+            if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+            {
+                loadConfig.seconds = (ma_uint32)ma_max(0, atoi(argv[i + 1]));
+                continue;
+            }
+
+            if (strcmp(argv[i], "--period-ms") == 0 && i + 1 < argc)
+            {
+                loadConfig.periodMs = (ma_uint32)ma_max(1, atoi(argv[i + 1]));
+                continue;
+            }
+
+            if (strcmp(argv[i], "--load") == 0 && i + 1 < argc)
+            {
+                loadConfig.loadThreads = (ma_uint32)ma_max(0, atoi(argv[i + 1]));
+                continue;
+            }
+
+            if (strcmp(argv[i], "--rt-priority") == 0 && i + 1 < argc)
+            {
+                loadConfig.rtPriority = ma_clamp(atoi(argv[i + 1]), 0, 99);
+                continue;
+            }
+
+            if (strcmp(argv[i], "--mixer-cpu") == 0 && i + 1 < argc)
+            {
+                loadConfig.mixerCpu = ma_max(-1, atoi(argv[i + 1]));
+                continue;
+            }
+        }
+
+        if (tcb_load_test(&loadConfig) != 0)
+        {
+            return 1;
+        }
     }
     else if (strcmp(argv[1], "transcribe") == 0)
     {
@@ -364,6 +2639,15 @@ int main(int argc, char **argv)
 
         char *language = "pt";
         bool use_gpu = false;
+        bool remote = false;
+        bool beam = false;
+        bool cache = true;
+        ma_uint32 formats = 1u << TCB_TRANSCRIPT_TXT;
+        int jobs = 1;
+        int threads = 0;
+        bool jobsSet = false;
+        char socketPath[512];
+        tcb_socket_path(socketPath, sizeof(socketPath));
         for (int i = 0; i < argc; i++)
         {
             if (strcmp(argv[i], "--language") == 0 && i + 1 < argc)
@@ -377,130 +2661,112 @@ int main(int argc, char **argv)
                 use_gpu = true;
                 continue;
             }
-        }
 
-        char *filePath = argv[2];
-        const char *dot = strrchr(filePath, '.');
-        if (!dot || dot == filePath)
-        {
-            fprintf(stderr, "Error: input file does not have a valid extension\n");
-            return -1;
-        }
+            if (strcmp(argv[i], "--remote") == 0)
+            {
+                remote = true;
+                continue;
+            }
 
-        printf("Transcribing file: %s\n", filePath);
-        ma_decoder decoder;
-        if (ma_decoder_init_file(filePath, NULL, &decoder) != MA_SUCCESS)
-        {
-            fprintf(stderr, "Failed to initialize decoder for file: %s\n", filePath);
-            return -1;
-        }
+            if (strcmp(argv[i], "--beam") == 0)
+            {
+                beam = true;
+                continue;
+            }
 
-        ma_uint64 framesSize;
-        if (ma_decoder_get_length_in_pcm_frames(&decoder, &framesSize) != MA_SUCCESS)
-        {
-            fprintf(stderr, "Failed to get length of file.\n");
-        }
+            if (strcmp(argv[i], "--no-cache") == 0)
+            {
+                cache = false;
+                continue;
+            }
 
-        ma_uint32 bytesPerFrame = ma_get_bytes_per_frame(decoder.outputFormat, decoder.outputChannels);
-        ma_uint32 bytesPerFrameNew = ma_get_bytes_per_frame(TARGET_FORMAT, TARGET_CHANNELS);
-        ma_uint64 bufferSize = framesSize * bytesPerFrame;
+            if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            {
+                if (tcb_transcript_format_parse(argv[i + 1], &formats) != MA_SUCCESS)
+                {
+                    return 1;
+                }
+                continue;
+            }
 
-        ma_float *audioBuffer = malloc(bufferSize);
-        ma_uint64 framesRead;
-        if (ma_decoder_read_pcm_frames(&decoder, audioBuffer, framesSize, &framesRead) != MA_SUCCESS)
-        {
-            fprintf(stderr, "Failed to read audio data.\n");
-        }
+            if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+            {
+                snprintf(socketPath, sizeof(socketPath), "%s", argv[i + 1]);
+                continue;
+            }
 
-        ma_data_converter_config converterConfig = ma_data_converter_config_init(
-            decoder.outputFormat,
-            TARGET_FORMAT,
-            decoder.outputChannels,
-            TARGET_CHANNELS,
-            decoder.outputSampleRate,
-            TARGET_SAMPLE_RATE);
+            if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+            {
+                jobs = atoi(argv[i + 1]);
+                jobsSet = true;
+                continue;
+            }
 
-        ma_data_converter converter;
-        ma_result result = ma_data_converter_init(&converterConfig, NULL, &converter);
-        if (result != MA_SUCCESS)
-        {
-            fprintf(stderr, "Failed to initialize data converter.\n");
-            return result;
+            if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            {
+                threads = ma_max(1, atoi(argv[i + 1]));
+                continue;
+            }
         }
 
-        ma_uint64 framesReadOut;
-        if (ma_data_converter_get_expected_output_frame_count(&converter, framesRead, &framesReadOut) != MA_SUCCESS)
+        char *filePath = argv[2];
+        if (remote)
         {
-            fprintf(stderr, "Failed to get expected output frame count.\n");
+            /* The server owns the model, so how it runs is decided when it starts. */
+            if (use_gpu || jobsSet)
+            {
+                fprintf(stderr, "--use-gpu and --jobs cannot be used with --remote, pass --use-gpu to tcb serve instead.\n");
+                return 1;
+            }
+            return tcb_transcribe_remote(socketPath, filePath, language, formats, beam, cache, threads);
         }
 
-        ma_float *audioBufferConverted = malloc(framesReadOut * bytesPerFrameNew);
+        tcb_split_cores(&jobs, &threads);
 
-        ma_uint64 frameCountOut;
-        result = ma_data_converter_process_pcm_frames(&converter, audioBuffer, &framesSize, audioBufferConverted, &frameCountOut);
-        if (result != MA_SUCCESS)
+        printf("Transcribing file: %s\n", filePath);
+        struct whisper_full_params params = tcb_whisper_params(language);
+        params.n_threads = threads;
+        if (beam)
         {
-            fprintf(stderr, "Failed to convert buffer(s).\n");
+            params.strategy = WHISPER_SAMPLING_BEAM_SEARCH;
+            params.beam_search.beam_size = WHISPER_BEAM_SIZE;
         }
 
-        char *home = getenv("HOME");
-        char model_path[512];
-        snprintf(model_path, sizeof(model_path), "%s/%s/%s", home, RECORD_FOLDER, MODEL_FILE);
-        whisper_log_set(cb_log_disable, NULL);
-
-        struct whisper_context_params cparams = whisper_context_default_params();
-        cparams.use_gpu = use_gpu;
-        cparams.flash_attn = true;
-        cparams.dtw_aheads_preset = WHISPER_AHEADS_LARGE_V3_TURBO;
-        struct whisper_context *ctx = whisper_init_from_file_with_params(model_path, cparams);
-        if (!ctx)
+        /* A file transcribed before is answered from the cache, the model is not even loaded. */
+        char outputPath[512];
+        if (cache && tcb_transcribe_cached(params, formats, filePath, outputPath, sizeof(outputPath), tcb_print_segment, NULL) == MA_SUCCESS)
         {
-            fprintf(stderr, "Failed to initialize whisper context.\n");
-            return 1;
+            printf("Transcription saved to: %s (cached)\n", outputPath);
+            return 0;
         }
 
-        struct whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
-        wparams.language = language;
-        wparams.n_threads = 4;
-        wparams.strategy = WHISPER_SAMPLING_BEAM_SEARCH;
-        wparams.beam_search.beam_size = 5;
-
-        if (whisper_full_parallel(ctx, wparams, audioBufferConverted, framesReadOut, 1) != 0)
+        struct whisper_context *ctx = jobs > 1 ? tcb_whisper_init_shared(use_gpu) : tcb_whisper_init(use_gpu);
+        if (!ctx)
         {
-            fprintf(stderr, "Failed to process audio\n");
-            free(audioBufferConverted);
-            whisper_free(ctx);
             return 1;
         }
 
-        char *output_filepath = (char *)malloc(strlen(filePath) + 1);
-        strcpy(output_filepath, filePath);
-        char *extension = strstr(output_filepath, dot);
-        strcpy(extension, ".txt");
-        FILE *outfile = fopen(output_filepath, "w");
-        printf("Transcription saved to: %s\n", output_filepath);
-
-        const int segments = whisper_full_n_segments(ctx);
-        for (int i = 0; i < segments; i++)
+        ma_result result = tcb_transcribe_file(ctx, NULL, params, (ma_uint32)jobs, cache, formats, filePath, outputPath, sizeof(outputPath), tcb_print_segment, NULL);
+        whisper_free(ctx);
+        if (result != MA_SUCCESS)
         {
-            const char *text = whisper_full_get_segment_text(ctx, i);
-            printf("%s\n", text);
-            fprintf(outfile, "%s\n", text);
+            return 1;
         }
-        fclose(outfile);
-        free(audioBuffer);
-        whisper_free(ctx);
+        printf("Transcription saved to: %s\n", outputPath);
     }
     else if (strcmp(argv[1], "record") == 0)
     {
-        if (argc < 4)
+        int deviceIndexCount = 0;
+        while (2 + deviceIndexCount < argc && strncmp(argv[2 + deviceIndexCount], "--", 2) != 0)
         {
-            fprintf(stderr, "Specify primary and secondary device IDs for recording.\n");
-            return -1;
+            deviceIndexCount++;
         }
 
-        int primaryDeviceId = atoi(argv[2]);
-        int secondaryDeviceId = atoi(argv[3]);
+        if (deviceIndexCount == 0)
+        {
+            fprintf(stderr, "Specify at least one device ID for recording.\n");
+            return -1;
+        }
 
         char filePath[512];
 
@@ -508,6 +2774,33 @@ int main(int argc, char **argv)
         char *language = "pt";
         bool use_gpu = false;
         bool no_transcribe = false;
+        bool stream = false;
+        ma_uint32 formats = 1u << TCB_TRANSCRIPT_TXT;
+        tcb_context_config contextConfig = tcb_context_config_init();
+        ma_float gains[64];
+        ma_uint32 gainCount = 0;
+
+        /* The profile is applied first so the options below can override any of its values. */
+        for (int i = 0; i < argc; i++)
+        {
+            if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+            {
+                if (strcmp(argv[i + 1], "low-latency") == 0)
+                {
+                    tcb_context_config_set_profile(&contextConfig, TCB_PROFILE_LOW_LATENCY);
+                }
+                else if (strcmp(argv[i + 1], "throughput") == 0)
+                {
+                    tcb_context_config_set_profile(&contextConfig, TCB_PROFILE_THROUGHPUT);
+                }
+                else
+                {
+                    fprintf(stderr, "Unknown profile: %s\n", argv[i + 1]);
+                    return -1;
+                }
+            }
+        }
+
         for (int i = 0; i < argc; i++)
         {
             if (strcmp(argv[i], "--record-name") == 0 && i + 1 < argc)
@@ -533,6 +2826,137 @@ int main(int argc, char **argv)
                 no_transcribe = true;
                 continue;
             }
+
+            if (strcmp(argv[i], "--stream") == 0)
+            {
+                stream = true;
+                continue;
+            }
+
+            if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            {
+                if (tcb_transcript_format_parse(argv[i + 1], &formats) != MA_SUCCESS)
+                {
+                    return -1;
+                }
+                continue;
+            }
+
+            if (strcmp(argv[i], "--gains") == 0 && i + 1 < argc)
+            {
+                gainCount = 0;
+                for (char *gain = strtok(argv[i + 1], ","); gain != NULL && gainCount < (ma_uint32)(sizeof(gains) / sizeof(gains[0])); gain = strtok(NULL, ","))
+                {
+                    gains[gainCount++] = (ma_float)atof(gain);
+                }
+                contextConfig.pGains = gains;
+                contextConfig.gainCount = gainCount;
+                continue;
+            }
+
+            if (strcmp(argv[i], "--stats") == 0)
+            {
+                contextConfig.statsIntervalMs = 10000;
+                if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9')
+                {
+                    contextConfig.statsIntervalMs = (ma_uint32)(atof(argv[i + 1]) * 1000);
+                }
+                continue;
+            }
+
+            if (strcmp(argv[i], "--no-drift-correction") == 0)
+            {
+                contextConfig.driftCorrection = false;
+                continue;
+            }
+
+            if (strcmp(argv[i], "--rt-priority") == 0 && i + 1 < argc)
+            {
+                contextConfig.mixerPriority = ma_clamp(atoi(argv[i + 1]), 0, 99);
+                continue;
+            }
+
+            if (strcmp(argv[i], "--mixer-cpu") == 0 && i + 1 < argc)
+            {
+                contextConfig.mixerCpu = ma_max(-1, atoi(argv[i + 1]));
+                continue;
+            }
+
+            if (strcmp(argv[i], "--wake-ms") == 0 && i + 1 < argc)
+            {
+                contextConfig.wakeThresholdMs = (ma_uint32)atoi(argv[i + 1]);
+                continue;
+            }
+
+            if (strcmp(argv[i], "--period-ms") == 0 && i + 1 < argc)
+            {
+                contextConfig.periodMs = (ma_uint32)ma_max(0, atoi(argv[i + 1]));
+                continue;
+            }
+
+            if (strcmp(argv[i], "--periods") == 0 && i + 1 < argc)
+            {
+                contextConfig.periods = (ma_uint32)ma_max(0, atoi(argv[i + 1]));
+                continue;
+            }
+
+            if (strcmp(argv[i], "--ring-ms") == 0 && i + 1 < argc)
+            {
+                contextConfig.ringMs = (ma_uint32)ma_max(0, atoi(argv[i + 1]));
+                continue;
+            }
+
+            if (strcmp(argv[i], "--block-ms") == 0 && i + 1 < argc)
+            {
+                contextConfig.mixBlockMs = (ma_uint32)ma_max(0, atoi(argv[i + 1]));
+                continue;
+            }
+
+            if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+            {
+                if (strcmp(argv[i + 1], "wav") == 0)
+                {
+                    contextConfig.format = TCB_FORMAT_WAV;
+                }
+                else if (strcmp(argv[i + 1], "flac") == 0)
+                {
+                    contextConfig.format = TCB_FORMAT_FLAC;
+                }
+                else if (strcmp(argv[i + 1], "opus") == 0)
+                {
+                    contextConfig.format = TCB_FORMAT_OPUS;
+                }
+                else
+                {
+                    fprintf(stderr, "Unknown format: %s\n", argv[i + 1]);
+                    return -1;
+                }
+                continue;
+            }
+
+            if (strcmp(argv[i], "--segment") == 0 && i + 1 < argc)
+            {
+                contextConfig.segmentMs = (ma_uint32)ma_max(0, atoi(argv[i + 1])) * 1000;
+                continue;
+            }
+
+            if (strcmp(argv[i], "--tracks") == 0 && i + 1 < argc)
+            {
+                if (strcmp(argv[i + 1], "multichannel") == 0)
+                {
+                    contextConfig.trackMode = TCB_TRACKS_MULTICHANNEL;
+                }
+                else if (strcmp(argv[i + 1], "separate") == 0)
+                {
+                    contextConfig.trackMode = TCB_TRACKS_SEPARATE;
+                }
+                else
+                {
+                    fprintf(stderr, "Unknown track mode: %s\n", argv[i + 1]);
+                    return -1;
+                }
+                continue;
+            }
         }
 
         char *home = getenv("HOME");
@@ -541,9 +2965,22 @@ int main(int argc, char **argv)
         char timestamp[64];
         strftime(timestamp, sizeof(timestamp), "%Y%m%d_%H%M%S", localtime(&now));
 
-        snprintf(filePath, sizeof(filePath), "%s/%s/%s_%s.wav", home, RECORD_FOLDER, filePrefix, timestamp);
+        snprintf(filePath, sizeof(filePath), "%s/%s/%s_%s.%s", home, RECORD_FOLDER, filePrefix, timestamp, tcb_output_format_extension(contextConfig.format));
+
+        if (contextConfig.segmentMs > 0)
+        {
+            char segmentPath[512];
+            tcb_segment_path(filePath, 0, segmentPath, sizeof(segmentPath));
+            printf("Recording to %u second segments: %s\n", contextConfig.segmentMs / 1000, segmentPath);
+        }
+        else
+        {
+            printf("Recording to file: %s\n", filePath);
+        }
 
-        printf("Recording to file: %s\n", filePath);
+        tcb_path_list recordedFiles = {0};
+        contextConfig.onFileClosed = tcb_record_file_closed;
+        contextConfig.pUserData = &recordedFiles;
 
         ma_context context;
         if (ma_context_init(NULL, 0, NULL, &context) != MA_SUCCESS)
@@ -562,116 +2999,198 @@ int main(int argc, char **argv)
             return -3;
         }
 
+        ma_device_id *deviceIds = malloc(deviceIndexCount * sizeof(ma_device_id));
+        if (deviceIds == NULL)
+        {
+            fprintf(stderr, "Failed to allocate memory for device IDs.\n");
+            return -3;
+        }
+
+        for (int i = 0; i < deviceIndexCount; i++)
+        {
+            int deviceIndex = atoi(argv[2 + i]);
+            if (deviceIndex < 0 || (ma_uint32)deviceIndex >= captureDeviceCount)
+            {
+                fprintf(stderr, "Invalid capture device: %s\n", argv[2 + i]);
+                free(deviceIds);
+                return -3;
+            }
+            deviceIds[i] = pCaptureDeviceInfos[deviceIndex].id;
+        }
+
         tcb_context tcbContext;
-        ma_result result = tcb_context_init(&tcbContext, filePath, &pCaptureDeviceInfos[primaryDeviceId].id, &pCaptureDeviceInfos[secondaryDeviceId].id);
+        ma_result result = tcb_context_init(&tcbContext, &contextConfig, filePath, deviceIds, (ma_uint32)deviceIndexCount);
+        free(deviceIds);
         if (result != MA_SUCCESS)
         {
             fprintf(stderr, "Failed to initialize tcb context.\n");
+            return -3;
         }
 
-        if (tcb_device_start(&tcbContext.primary) != MA_SUCCESS)
+        struct whisper_context *streamCtx = NULL;
+        tcb_stream transcriptionStream;
+        if (stream && !no_transcribe)
         {
-            fprintf(stderr, "Failed to start primary device.\n");
+            char transcriptPath[512];
+            snprintf(transcriptPath, sizeof(transcriptPath), "%s/%s/%s_%s.txt", home, RECORD_FOLDER, filePrefix, timestamp);
+
+            streamCtx = tcb_whisper_init(use_gpu);
+            if (!streamCtx)
+            {
+                return 1;
+            }
+
+            tcb_stream_config streamConfig = tcb_stream_config_init(streamCtx, tcb_whisper_params(language), transcriptPath);
+            streamConfig.formats = formats;
+            streamConfig.timestamps = true;
+            streamConfig.onSegment = tcb_print_timestamped_segment;
+            if (tcb_stream_init(&transcriptionStream, &streamConfig) != MA_SUCCESS)
+            {
+                whisper_free(streamCtx);
+                return 1;
+            }
+            tcbContext.stream = &transcriptionStream;
+            printf("Streaming transcription to: %s\n", transcriptPath);
         }
 
-        if (tcb_device_start(&tcbContext.secundary) != MA_SUCCESS)
+        if (tcb_context_start(&tcbContext) != MA_SUCCESS)
         {
-            fprintf(stderr, "Failed to start secundary device.\n");
+            fprintf(stderr, "Failed to start recording.\n");
+            tcb_context_uninit(&tcbContext);
+            ma_context_uninit(&context);
+            if (tcbContext.stream != NULL)
+            {
+                tcb_stream_finish(tcbContext.stream);
+                tcb_stream_uninit(tcbContext.stream);
+                whisper_free(streamCtx);
+            }
+            free(recordedFiles.paths);
+            return -3;
         }
 
-        pthread_t thread;
-        pthread_create(&thread, NULL, rb_read_thread, (void *)(&tcbContext));
-
         printf("Press Enter to stop recording...\n");
-        getchar();
+        tcb_wait_for_stop();
 
+        tcb_context_stop(&tcbContext);
+        if (contextConfig.statsIntervalMs > 0)
+        {
+            char statsPath[512];
+            snprintf(statsPath, sizeof(statsPath), "%s/%s/%s_%s.stats.json", home, RECORD_FOLDER, filePrefix, timestamp);
+            if (tcb_stats_write_json(&tcbContext, statsPath) == MA_SUCCESS)
+            {
+                printf("Capture stats saved to: %s\n", statsPath);
+            }
+        }
         tcb_context_uninit(&tcbContext);
-        pthread_cancel(thread);
 
         ma_context_uninit(&context);
 
-        printf("Audio file saved to: %s\n", filePath);
 
-        if (!no_transcribe)
+        if (tcbContext.stream != NULL)
         {
-            ma_decoder_config decoder_config = ma_decoder_config_init(TARGET_FORMAT, TARGET_CHANNELS, TARGET_SAMPLE_RATE);
-
-            ma_decoder decoder;
-            if (ma_decoder_init_file(filePath, &decoder_config, &decoder) != MA_SUCCESS)
+            tcb_stream_finish(tcbContext.stream);
+            printf("Speech sent to whisper: %.1f of %.1f s\n",
+                   (double)tcbContext.stream->speechFrames / TARGET_SAMPLE_RATE,
+                   (double)tcbContext.stream->inputFrames / TARGET_SAMPLE_RATE);
+            if (tcbContext.stream->failedChunks == 0)
             {
-                fprintf(stderr, "Failed to initialize decoder for file: %s\n", filePath);
+                tcb_index_add(filePath, &tcbContext.stream->transcript);
             }
-
-            ma_uint64 framesSize;
-            if (ma_decoder_get_length_in_pcm_frames(&decoder, &framesSize) != MA_SUCCESS)
+            tcb_catalog_add(filePath, tcbContext.stream->failedChunks == 0 ? TCB_RECORD_TRANSCRIBED : TCB_RECORD_FAILED, language);
+            tcb_stream_uninit(tcbContext.stream);
+            whisper_free(streamCtx);
+        }
+        else if (!no_transcribe)
+        {
+            struct whisper_context *ctx = tcb_whisper_init(use_gpu);
+            if (!ctx)
             {
-                fprintf(stderr, "Failed to get length of file.\n");
+                return 1;
             }
 
-            ma_uint32 bytesPerFrameNew = ma_get_bytes_per_frame(TARGET_FORMAT, TARGET_CHANNELS);
-            ma_uint64 bufferSize = framesSize * bytesPerFrameNew;
-
-            ma_float *audioBuffer = malloc(bufferSize);
-            ma_uint64 framesRead;
-            if (ma_decoder_read_pcm_frames(&decoder, audioBuffer, framesSize, &framesRead) != MA_SUCCESS)
+            /* Segments are complete recordings of their own and get a transcript each. */
+            for (size_t i = 0; i < recordedFiles.count; i++)
             {
-                fprintf(stderr, "Failed to read audio data.\n");
+                char outputPath[512];
+                result = tcb_transcribe_file(ctx, NULL, tcb_whisper_params(language), 1, true, formats, recordedFiles.paths[i], outputPath, sizeof(outputPath), tcb_print_segment, NULL);
+                if (result != MA_SUCCESS)
+                {
+                    break;
+                }
+                printf("Transcription saved to: %s\n", outputPath);
             }
-
-            char model_path[512];
-            snprintf(model_path, sizeof(model_path), "%s/%s/%s", home, RECORD_FOLDER, MODEL_FILE);
-            whisper_log_set(cb_log_disable, NULL);
-            struct whisper_context_params cparams = whisper_context_default_params();
-            cparams.use_gpu = use_gpu;
-            cparams.flash_attn = true;
-            cparams.dtw_aheads_preset = WHISPER_AHEADS_LARGE_V3_TURBO;
-            struct whisper_context *ctx = whisper_init_from_file_with_params(model_path, cparams);
-            if (!ctx)
+            whisper_free(ctx);
+            if (result != MA_SUCCESS)
             {
-                fprintf(stderr, "Failed to initialize whisper context.\n");
+                free(recordedFiles.paths);
                 return 1;
             }
+        }
+        free(recordedFiles.paths);
+    }
+    else if (strcmp(argv[1], "transcribe-all") == 0)
+    {
+        char *language = "pt";
+        bool use_gpu = false;
+        int threads = 0;
+        int jobs = 0;
+        for (int i = 0; i < argc; i++)
+        {
+            if (strcmp(argv[i], "--language") == 0 && i + 1 < argc)
+            {
+                language = argv[i + 1];
+                continue;
+            }
 
-            struct whisper_full_params wparams = whisper_full_default_params(WHISPER_SAMPLING_GREEDY);
-            wparams.language = language;
-            wparams.n_threads = 4;
-            wparams.strategy = WHISPER_SAMPLING_BEAM_SEARCH;
-            wparams.beam_search.beam_size = 5;
+            if (strcmp(argv[i], "--use-gpu") == 0)
+            {
+                use_gpu = true;
+                continue;
+            }
 
-            if (whisper_full_parallel(ctx, wparams, audioBuffer, framesSize, 1) != 0)
+            if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
             {
-                fprintf(stderr, "Failed to process audio\n");
-                free(audioBuffer);
-                whisper_free(ctx);
-                return 1;
+                jobs = atoi(argv[i + 1]);
+                continue;
             }
 
-            char *output_filepath = (char *)malloc(strlen(filePath) + 1);
-            strcpy(output_filepath, filePath);
-            char *extension = strstr(output_filepath, ".wav");
-            if (extension == NULL)
+            if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
             {
-                fprintf(stderr, "Error: input file is not a .wav file\n");
-                free(audioBuffer);
-                whisper_free(ctx);
-                return 1;
+                threads = ma_max(1, atoi(argv[i + 1]));
+                continue;
             }
+        }
 
-            strcpy(extension, ".txt");
+        tcb_split_cores(&jobs, &threads);
 
-            FILE *outfile = fopen(output_filepath, "w");
-            printf("Transcription saved to: %s\n", output_filepath);
+        if (tcb_transcribe_all(language, use_gpu, jobs, threads) != 0)
+        {
+            return 1;
+        }
+    }
+    else if (strcmp(argv[1], "serve") == 0)
+    {
+        bool use_gpu = false;
+        char socketPath[512];
+        tcb_socket_path(socketPath, sizeof(socketPath));
+        for (int i = 0; i < argc; i++)
+        {
+            if (strcmp(argv[i], "--use-gpu") == 0)
+            {
+                use_gpu = true;
+                continue;
+            }
 
-            const int segments = whisper_full_n_segments(ctx);
-            for (int i = 0; i < segments; i++)
+            if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
             {
-                const char *text = whisper_full_get_segment_text(ctx, i);
-                printf("%s\n", text);
-                fprintf(outfile, "%s\n", text);
+                snprintf(socketPath, sizeof(socketPath), "%s", argv[i + 1]);
+                continue;
             }
-            fclose(outfile);
-            free(audioBuffer);
-            whisper_free(ctx);
+        }
+
+        if (tcb_serve(socketPath, use_gpu) != 0)
+        {
+            return 1;
         }
     }
     else
@@ -4,42 +4,818 @@
 #include "miniaudio.h"
 #include "whisper.h"
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+#include <sndfile.h>
 
 #define RECORD_FOLDER ".tcb"
-#define BUFFER_SIZE_IN_FRAMES 1024 * 16
 
 #define TARGET_FORMAT ma_format_f32
 #define TARGET_CHANNELS 1
 #define TARGET_SAMPLE_RATE 16000
 
 #define MODEL_FILE "ggml-large-v3-turbo-q5_0.bin"
+#define WHISPER_JOB_THREADS 4
+#define WHISPER_BEAM_SIZE 5
+#define SERVE_SOCKET_FILE "tcb.sock"
 
+#define ARENA_ALIGNMENT 64
+
+#define MIXER_WAKE_THRESHOLD_MS 50
+#define MIXER_WAKE_TIMEOUT_MS 500
+#define MIXER_RT_PRIORITY 80
+
+#define CAPTURE_RING_MS 350
+
+#define WRITER_RING_MS 5000
+#define WRITER_CHECKPOINT_MS 2000
+
+#define DRIFT_FILTER_MS 1000
+#define DRIFT_KP 0.1
+#define DRIFT_KI 0.0025
+#define DRIFT_MAX_PPM 5000
+#define DRIFT_RATE_LIMIT 2000000000u
+
+#define DECODE_BLOCK_FRAMES 16000
+
+#define VAD_FRAME_MS 20
+#define VAD_FLOOR_PERCENTILE 10
+#define VAD_MARGIN_DB 12.0f
+#define VAD_MIN_DB -55.0f
+#define VAD_PAD_MS 300
+#define VAD_MIN_SILENCE_MS 1000
+
+#define STREAM_WINDOW_MS 30000
+#define STREAM_SPLIT_SEARCH_MS 5000
+#define STREAM_FEED_RING_MS 5000
+
+#define REFINE_LOGPROB_THRESHOLD -1.0f
+#define REFINE_ENTROPY_THRESHOLD 2.4f
+#define REFINE_ENTROPY_TOKENS 32
+#define REFINE_PAD_MS 200
+
+#define CATALOG_FILE "catalog"
+#define CATALOG_SETTLE_MS 1000
+
+#define INDEX_FOLDER "index"
+#define INDEX_BUCKETS 1024
+#define INDEX_SEARCH_LIMIT 50
+
+#define CACHE_FOLDER "cache"
+#define CACHE_VERSION 2
+
+#define BENCH_PERIOD_MS 10
+#define BENCH_SECONDS 60
+
+#define LOAD_TEST_SECONDS 20
+#define LOAD_TEST_BUFFER_BYTES (4 * 1024 * 1024)
+
+typedef struct tcb_arena tcb_arena;
+typedef struct tcb_mix_kernel tcb_mix_kernel;
+typedef struct tcb_device_stats tcb_device_stats;
 typedef struct tcb_device tcb_device;
+typedef struct tcb_writer_track tcb_writer_track;
+typedef struct tcb_path_list tcb_path_list;
+typedef struct tcb_writer_config tcb_writer_config;
+typedef struct tcb_writer tcb_writer;
+typedef struct tcb_context_config tcb_context_config;
+
+typedef enum
+{
+    TCB_FORMAT_WAV,
+    TCB_FORMAT_FLAC,
+    TCB_FORMAT_OPUS
+} tcb_output_format;
+
+typedef enum
+{
+    TCB_TRACKS_NONE,
+    TCB_TRACKS_MULTICHANNEL,
+    TCB_TRACKS_SEPARATE
+} tcb_track_mode;
+
+typedef enum
+{
+    TCB_TRANSCRIPT_TXT,
+    TCB_TRANSCRIPT_SRT,
+    TCB_TRANSCRIPT_VTT,
+    TCB_TRANSCRIPT_JSON,
+    TCB_TRANSCRIPT_FORMAT_COUNT
+} tcb_transcript_format;
+
+typedef enum
+{
+    TCB_PROFILE_DEFAULT,
+    TCB_PROFILE_LOW_LATENCY,
+    TCB_PROFILE_THROUGHPUT
+} tcb_latency_profile;
+
+/* Failures on the real-time paths, raised with atomic_fetch_or and printed off them. */
+typedef enum
+{
+    TCB_ERROR_RING_ACQUIRE = 1 << 0,
+    TCB_ERROR_RING_COMMIT = 1 << 1,
+    TCB_ERROR_MIXER_WAKE = 1 << 2,
+    TCB_ERROR_WRITER_WAKE = 1 << 3,
+    TCB_ERROR_STREAM_PUSH = 1 << 4,
+    TCB_ERROR_STREAM_OVERFLOW = 1 << 5,
+    TCB_ERROR_STREAM_WAKE = 1 << 6,
+    TCB_ERROR_CONVERT = 1 << 7
+} tcb_error_flag;
+
+typedef enum
+{
+    TCB_RECORD_RECORDED,
+    TCB_RECORD_TRANSCRIBED,
+    TCB_RECORD_FAILED
+} tcb_record_status;
+
+typedef enum
+{
+    TCB_CATALOG_SORT_DATE,
+    TCB_CATALOG_SORT_DURATION,
+    TCB_CATALOG_SORT_SIZE,
+    TCB_CATALOG_SORT_NAME
+} tcb_catalog_sort;
+
 typedef struct tcb_context tcb_context;
+typedef struct tcb_reader tcb_reader;
+typedef struct tcb_mapped_wav tcb_mapped_wav;
+typedef struct tcb_vad_span tcb_vad_span;
+typedef struct tcb_vad tcb_vad;
+typedef struct tcb_stream_config tcb_stream_config;
+typedef struct tcb_stream_worker tcb_stream_worker;
+typedef struct tcb_refine_job tcb_refine_job;
+typedef struct tcb_stream tcb_stream;
+typedef struct tcb_index_segment tcb_index_segment;
+typedef struct tcb_transcript tcb_transcript;
+typedef struct tcb_hash tcb_hash;
+typedef struct tcb_cache_token tcb_cache_token;
+typedef struct tcb_cache_segment tcb_cache_segment;
+typedef struct tcb_cache_entry tcb_cache_entry;
+typedef struct tcb_transcript_writer tcb_transcript_writer;
+typedef struct tcb_catalog_filter tcb_catalog_filter;
+typedef struct tcb_bench_config tcb_bench_config;
+typedef struct tcb_bench_result tcb_bench_result;
+typedef struct tcb_load_config tcb_load_config;
 
+ma_result tcb_arena_init(tcb_arena *arena, size_t capacity);
+void *tcb_arena_alloc(tcb_arena *arena, size_t size);
+void tcb_arena_reset(tcb_arena *arena);
+void tcb_arena_uninit(tcb_arena *arena);
+typedef void (*tcb_mix_proc)(ma_float *pOut, const ma_float *const *ppSources, const ma_float *pGains, ma_uint32 sourceCount, ma_uint64 frameCount);
+void tcb_mix_scalar(ma_float *pOut, const ma_float *const *ppSources, const ma_float *pGains, ma_uint32 sourceCount, ma_uint64 frameCount);
+const tcb_mix_kernel *tcb_mix_kernels(size_t *pCount);
+const tcb_mix_kernel *tcb_mix_kernel_select(void);
+int tcb_mix_bench(ma_uint32 sourceCount, ma_uint64 frameCount, ma_uint32 iterations);
 void rb_write_callback(ma_device *pDevice, void *pOutput, const void *pInput, ma_uint32 frameCount);
-ma_result tcb_device_init(ma_device_id *device_id, tcb_device *device);
+ma_result tcb_device_init(const tcb_context_config *config, ma_device_id *device_id, const ma_allocation_callbacks *pAllocationCallbacks, tcb_device *device);
 ma_result tcb_device_start(tcb_device *device);
+ma_uint64 tcb_device_read_converted(tcb_device *device, ma_float *pFramesOut, ma_uint64 frameCount);
 void tcb_device_uninit(tcb_device *device);
-ma_result tcb_context_init(tcb_context *context, const char *pFilePath, ma_device_id *primary_device_id, ma_device_id *secundary_device_id);
+typedef void (*tcb_file_closed_proc)(void *pUserData, ma_uint32 track, const char *pFilePath);
+const char *tcb_output_format_extension(tcb_output_format format);
+ma_result tcb_track_path(const char *pFilePath, int track, char *pOutputPath, size_t outputPathSize);
+ma_result tcb_segment_path(const char *pFilePath, ma_uint32 segment, char *pOutputPath, size_t outputPathSize);
+tcb_writer_config tcb_writer_config_init(const char *pFilePath, ma_uint32 sourceCount);
+ma_result tcb_writer_init(tcb_writer *writer, const tcb_writer_config *config);
+ma_result tcb_writer_start(tcb_writer *writer);
+void tcb_writer_write_sources(tcb_writer *writer, const ma_float *const *ppSources, ma_uint32 sourceCount, ma_uint64 frameCount);
+ma_result tcb_writer_write_mix(tcb_writer *writer, const ma_float *pMix, ma_uint64 frameCount);
+void tcb_writer_stop(tcb_writer *writer);
+ma_uint64 tcb_writer_dropped_frames(tcb_writer *writer);
+ma_uint32 tcb_writer_available_frames(tcb_writer *writer);
+void tcb_writer_uninit(tcb_writer *writer);
+void *tcb_writer_thread(void *arg);
+void tcb_wait_for_stop(void);
+void tcb_record_file_closed(void *pUserData, ma_uint32 track, const char *pFilePath);
+tcb_context_config tcb_context_config_init(void);
+void tcb_context_config_set_profile(tcb_context_config *config, tcb_latency_profile profile);
+ma_result tcb_context_init(tcb_context *context, const tcb_context_config *config, const char *pFilePath, ma_device_id *pDeviceIds, ma_uint32 deviceCount);
+ma_result tcb_context_start(tcb_context *context);
+ma_result tcb_context_start_mixer(tcb_context *context);
+void tcb_context_stop(tcb_context *context);
+void tcb_context_stop_mixer(tcb_context *context);
+void tcb_context_report_errors(tcb_context *context);
+ma_uint64 tcb_context_heap_calls(tcb_context *context);
+ma_uint64 tcb_context_mix(tcb_context *context);
+void tcb_context_correct_drift(tcb_context *context);
 void tcb_context_uninit(tcb_context *context);
+ma_uint64 tcb_time_ns(void);
+ma_uint32 tcb_cpu_cores(void);
+void tcb_split_cores(int *pJobs, int *pThreads);
+ma_result tcb_thread_set_realtime(pthread_t thread, int priority, int cpu);
 void ensure_record_folder();
 void list_devices(ma_context *context);
-void list_records();
+bool tcb_is_record_file(const char *pFileName);
 void *rb_read_thread(void *arg);
+struct whisper_context *tcb_whisper_init(bool use_gpu);
+struct whisper_context *tcb_whisper_init_shared(bool use_gpu);
+int tcb_whisper_full(struct whisper_context *ctx, struct whisper_state *state, struct whisper_full_params params, const float *samples, int sampleCount);
+int tcb_whisper_n_segments(struct whisper_context *ctx, struct whisper_state *state);
+const char *tcb_whisper_segment(struct whisper_context *ctx, struct whisper_state *state, int i, ma_int64 *pT0Ms, ma_int64 *pT1Ms);
+float tcb_whisper_segment_logprob(struct whisper_context *ctx, struct whisper_state *state, int i, float *pEntropy);
+ma_result tcb_whisper_segment_tokens(struct whisper_context *ctx, struct whisper_state *state, int i, tcb_cache_entry *entry);
+struct whisper_full_params tcb_whisper_params(const char *language);
+void tcb_format_timestamp(char *buffer, size_t bufferSize, ma_int64 ms);
+typedef void (*tcb_segment_proc)(void *pUserData, ma_int64 t0Ms, ma_int64 t1Ms, const char *text);
+ma_result tcb_transcript_path(const char *pFilePath, char *pOutputPath, size_t outputPathSize);
+void tcb_print_segment(void *pUserData, ma_int64 t0Ms, ma_int64 t1Ms, const char *text);
+void tcb_print_timestamped_segment(void *pUserData, ma_int64 t0Ms, ma_int64 t1Ms, const char *text);
+ma_result tcb_transcribe_file(struct whisper_context *ctx, struct whisper_state *state, struct whisper_full_params params, ma_uint32 jobs, bool cache, ma_uint32 formats, const char *pFilePath, char *pOutputPath, size_t outputPathSize, tcb_segment_proc onSegment, void *pUserData);
+ma_result tcb_transcribe_cached(struct whisper_full_params params, ma_uint32 formats, const char *pFilePath, char *pOutputPath, size_t outputPathSize, tcb_segment_proc onSegment, void *pUserData);
+ma_result tcb_reader_init(tcb_reader *reader, const char *pFilePath);
+ma_result tcb_reader_read(tcb_reader *reader, ma_float *pFramesOut, ma_uint64 frameCount, ma_uint64 *pFramesRead);
+void tcb_reader_uninit(tcb_reader *reader);
+ma_result tcb_mapped_wav_open(tcb_mapped_wav *map, const char *pFilePath);
+void tcb_mapped_wav_close(tcb_mapped_wav *map);
+ma_result tcb_vad_init(tcb_vad *vad, ma_uint64 maxFrames);
+void tcb_vad_uninit(tcb_vad *vad);
+ma_uint64 tcb_vad_detect(tcb_vad *vad, const ma_float *samples, ma_uint64 frameCount);
+void tcb_vad_pack(const tcb_vad *vad, const ma_float *samples, ma_float *pPacked);
+ma_int64 tcb_vad_map_ms(const tcb_vad *vad, ma_int64 packedMs);
+tcb_stream_config tcb_stream_config_init(struct whisper_context *whisper, struct whisper_full_params params, const char *pOutputPath);
+ma_result tcb_stream_init(tcb_stream *stream, const tcb_stream_config *config);
+ma_result tcb_stream_push(tcb_stream *stream, const ma_float *frames, ma_uint64 frameCount);
+void tcb_stream_finish(tcb_stream *stream);
+void tcb_stream_uninit(tcb_stream *stream);
+void *tcb_stream_thread(void *arg);
+void tcb_stats_print(tcb_context *context, FILE *file);
+void *tcb_stats_thread(void *arg);
+ma_result tcb_stats_write_json(tcb_context *context, const char *pFilePath);
+void tcb_socket_path(char *pSocketPath, size_t socketPathSize);
+int tcb_serve(const char *pSocketPath, bool use_gpu);
+int tcb_transcribe_remote(const char *pSocketPath, const char *pFilePath, const char *language, ma_uint32 formats, bool beam, bool cache, int threads);
+int tcb_transcribe_all(const char *language, bool use_gpu, int jobs, int threads);
+ma_result tcb_transcript_append(tcb_transcript *transcript, ma_int64 t0Ms, ma_int64 t1Ms, const char *text);
+ma_result tcb_transcript_replace(tcb_transcript *transcript, size_t segment, const char *text);
+void tcb_transcript_uninit(tcb_transcript *transcript);
+ma_result tcb_index_add(const char *pRecordingPath, const tcb_transcript *transcript);
+int tcb_index_missing(void);
+void tcb_hash_init(tcb_hash *hash, ma_uint64 seed);
+void tcb_hash_update(tcb_hash *hash, const void *pData, size_t size);
+ma_uint64 tcb_hash_final(const tcb_hash *hash);
+void tcb_cache_key_init(tcb_hash *hash, const struct whisper_full_params *params, const char *pKind);
+ma_uint64 tcb_cache_key(const struct whisper_full_params *params, const char *pKind, const ma_float *pFrames, ma_uint64 frameCount);
+ma_uint64 tcb_cache_alias_key(const struct whisper_full_params *params, const char *pFilePath);
+ma_result tcb_cache_entry_append(tcb_cache_entry *entry, ma_int64 t0Ms, ma_int64 t1Ms, float logprob, float entropy, const char *text, size_t length);
+ma_result tcb_cache_entry_append_token(tcb_cache_entry *entry, ma_int32 id, float p, const char *text);
+ma_result tcb_cache_entry_copy(tcb_cache_entry *entry, const tcb_cache_entry *pSource, size_t segment, ma_int64 t0Ms, ma_int64 t1Ms);
+ma_result tcb_cache_entry_replace(tcb_cache_entry *entry, size_t segment, const tcb_cache_entry *pSource);
+const char *tcb_cache_entry_text(const tcb_cache_entry *entry, size_t segment);
+const char *tcb_cache_entry_token_text(const tcb_cache_entry *entry, size_t token);
+void tcb_cache_entry_reset(tcb_cache_entry *entry);
+void tcb_cache_entry_uninit(tcb_cache_entry *entry);
+ma_result tcb_cache_load(ma_uint64 key, tcb_cache_entry *entry);
+ma_result tcb_cache_store(ma_uint64 key, const tcb_cache_entry *entry);
+ma_result tcb_cache_alias_load(ma_uint64 alias, ma_uint64 *pKey);
+ma_result tcb_cache_alias_store(ma_uint64 alias, ma_uint64 key);
+ma_result tcb_transcript_format_parse(const char *pList, ma_uint32 *pFormats);
+ma_result tcb_transcript_writer_open(tcb_transcript_writer *writer, const char *pTextPath, ma_uint32 formats, bool timestamps);
+void tcb_transcript_writer_segment(tcb_transcript_writer *writer, const tcb_cache_entry *entry, size_t segment);
+void tcb_transcript_writer_refined(tcb_transcript_writer *writer, const tcb_cache_entry *entry, size_t segment);
+ma_result tcb_transcript_writer_rewrite(tcb_transcript_writer *writer, const tcb_cache_entry *entry);
+void tcb_transcript_writer_flush(tcb_transcript_writer *writer);
+ma_result tcb_transcript_writer_close(tcb_transcript_writer *writer);
+int tcb_index_search(const char *pQuery, ma_uint32 limit);
+tcb_catalog_filter tcb_catalog_filter_init(void);
+void tcb_catalog_add(const char *pFilePath, tcb_record_status status, const char *language);
+ma_uint64 tcb_catalog_probe_duration(const char *pFilePath);
+int tcb_catalog_list(const tcb_catalog_filter *filter);
+tcb_bench_config tcb_bench_config_init(void);
+int tcb_bench(const tcb_bench_config *config);
+tcb_load_config tcb_load_config_init(void);
+int tcb_load_test(const tcb_load_config *config);
+
+/*
+ * Bump allocator over one block reserved up front. heapCalls counts every
+ * trip to the system allocator, so a steady state can be checked for zero.
+ */
+struct tcb_arena
+{
+    ma_uint8 *base;
+    size_t capacity;
+    size_t offset;
+    ma_uint64 heapCalls;
+};
+
+/*
+ * Sums sourceCount buffers with a gain each and clamps to [-1, 1]. pOut may
+ * alias the first source. All variants are bit-identical to tcb_mix_scalar.
+ */
+struct tcb_mix_kernel
+{
+    const char *name;
+    tcb_mix_proc proc;
+    bool (*supported)(void);
+};
+
+/*
+ * Written by the capture callback and the mixer, read by anyone. Frame
+ * counts are at the device rate except underrunFrames, which counts
+ * TARGET_SAMPLE_RATE frames the mixer had to fill with silence. errors holds
+ * the tcb_error_flag bits the callback raised since they were last printed.
+ */
+struct tcb_device_stats
+{
+    _Atomic ma_uint64 framesCaptured;
+    _Atomic ma_uint64 framesDropped;
+    _Atomic ma_uint32 fillHighWater;
+    _Atomic ma_uint64 callbacks;
+    _Atomic ma_uint64 jitterTotalNs;
+    _Atomic ma_uint64 jitterMaxNs;
+    _Atomic ma_uint64 mixerLagMaxFrames;
+    _Atomic ma_uint64 underrunFrames;
+    _Atomic float driftPpm;
+    _Atomic ma_uint32 errors;
+};
 
 struct tcb_device
 {
     ma_device device;
     ma_pcm_rb rb;
+    ma_uint32 ringFrames;
     ma_data_converter converter;
+    const ma_allocation_callbacks *pAllocationCallbacks;
+    int wakeFd;
+    ma_uint32 wakeThresholdFrames;
+    ma_uint32 pendingFrames;
+    ma_uint64 lastCallbackNs;
+    _Atomic ma_uint64 wakeTimeNs;
+    double nominalRatio;
+    double rateRatio;
+    double driftError;
+    double driftIntegral;
+    ma_uint64 driftLastNs;
+    tcb_device_stats stats;
+};
+
+/*
+ * Disk output runs on its own thread. The mixer copies each block into one
+ * SPSC ring per output file and never touches the encoder itself, so FLAC
+ * and Opus encoding through libsndfile cost the mixer nothing. Track 0
+ * is the mix; with tracks enabled the converted sources follow, either as
+ * the channels of one <name>.tracks.wav or as <name>.track<n>.wav each.
+ * With segmentMs set every track rotates into <name>.part<n> files of that
+ * length, and each closed file is reported through onFileClosed.
+ */
+struct tcb_path_list
+{
+    char (*paths)[512];
+    size_t count;
+    size_t capacity;
+};
+
+struct tcb_writer_config
+{
+    const char *pFilePath;
+    tcb_output_format format;
+    tcb_track_mode trackMode;
+    ma_uint32 sourceCount;
+    ma_uint32 segmentMs;
+    ma_uint32 checkpointMs;
+    tcb_file_closed_proc onFileClosed;
+    void *pUserData;
+    const ma_allocation_callbacks *pAllocationCallbacks;
+};
+
+struct tcb_writer_track
+{
+    SNDFILE *file;
+    char path[512];
+    ma_uint32 segment;
+    ma_uint64 segmentFramesWritten;
+    ma_pcm_rb rb;
+    ma_uint32 channels;
+    bool rbReady;
+    _Atomic ma_uint64 droppedFrames;
+};
+
+struct tcb_writer
+{
+    char filePath[512];
+    tcb_output_format format;
+    tcb_writer_track *tracks;
+    ma_uint32 trackCount;
+    tcb_track_mode trackMode;
+    ma_uint64 segmentFrames;
+    ma_uint32 checkpointMs;
+    ma_uint64 lastCheckpointNs;
+    tcb_file_closed_proc onFileClosed;
+    void *pUserData;
+    pthread_t thread;
+    int wakeFd;
+    atomic_bool running;
+    bool started;
 };
 
+/*
+ * Capture timing is set in milliseconds so every device gets the same
+ * latency whatever its native rate. periodMs and periods go to miniaudio, 0
+ * keeps the backend's choice. ringMs sizes each device ring, mixBlockMs
+ * caps what the mixer converts per pass, 0 being a whole ring.
+ */
+struct tcb_context_config
+{
+    ma_context *pContext;
+    ma_performance_profile performanceProfile;
+    ma_uint32 periodMs;
+    ma_uint32 periods;
+    ma_uint32 ringMs;
+    ma_uint32 mixBlockMs;
+    const ma_float *pGains;
+    ma_uint32 gainCount;
+    ma_uint32 wakeThresholdMs;
+    ma_uint32 wakeTimeoutMs;
+    ma_uint32 statsIntervalMs;
+    bool driftCorrection;
+    tcb_output_format format;
+    tcb_track_mode trackMode;
+    ma_uint32 segmentMs;
+    tcb_file_closed_proc onFileClosed;
+    void *pUserData;
+    int mixerPriority;
+    int mixerCpu;
+};
+
+/*
+ * Device rings, converters, writer rings and the feed ring all allocate
+ * through allocationCallbacks, which count into heapCalls. The baseline is
+ * taken once they exist, so what is left is what recording itself asked for.
+ */
 struct tcb_context
 {
-    tcb_device primary;
-    tcb_device secundary;
-    ma_encoder encoder;
+    tcb_device *devices;
+    ma_uint32 deviceCount;
+    tcb_writer writer;
+    tcb_stream *stream;
+    tcb_arena scratch;
+    ma_uint64 scratchFrames;
+    const tcb_mix_kernel *mixKernel;
+    const ma_float **mixSources;
+    ma_float *gains;
+    _Atomic ma_uint64 heapCalls;
+    ma_uint64 heapCallsBaseline;
+    ma_allocation_callbacks allocationCallbacks;
+    pthread_t thread;
+    int wakeFd;
+    ma_uint32 wakeTimeoutMs;
+    bool driftCorrection;
+    atomic_bool running;
+    ma_uint64 wakeups;
+    ma_uint64 mixLatencyCount;
+    ma_uint64 mixLatencyTotalNs;
+    ma_uint64 mixLatencyMaxNs;
+    ma_uint64 startNs;
+    pthread_t statsThread;
+    int statsFd;
+    ma_uint32 statsIntervalMs;
+    int mixerPriority;
+    int mixerCpu;
+    _Atomic ma_uint32 errors;
+    ma_pcm_rb feedRb;
+    pthread_t feedThread;
+    int feedFd;
+    atomic_bool feedRunning;
+    bool feedStarted;
+    _Atomic ma_uint64 feedDroppedFrames;
+};
+
+/*
+ * Reads any recording as TARGET_FORMAT frames, through miniaudio's decoder
+ * when it knows the format and libsndfile otherwise.
+ */
+struct tcb_reader
+{
+    bool useDecoder;
+    ma_decoder decoder;
+    SNDFILE *file;
+    SF_INFO info;
+    ma_data_converter converter;
+    float *block;
+    ma_uint64 blockFrames;
+    ma_uint64 blockOffset;
+    bool atEnd;
+};
+
+/*
+ * A WAV that is already TARGET_FORMAT mono at TARGET_SAMPLE_RATE, mapped
+ * read-only so pFrames points straight at its samples.
+ */
+struct tcb_mapped_wav
+{
+    void *base;
+    size_t size;
+    const ma_float *pFrames;
+    ma_uint64 frameCount;
+};
+
+/*
+ * Energy based voice activity detection over one window. Blocks louder than
+ * the window's noise floor by VAD_MARGIN_DB are speech; spans are padded by
+ * VAD_PAD_MS and silences shorter than VAD_MIN_SILENCE_MS are kept, so
+ * whisper still hears natural pauses. tcb_vad_detect finds the spans and
+ * returns their total length, tcb_vad_pack copies them back to back (in
+ * place is fine) and tcb_vad_map_ms maps a time in the packed audio back to
+ * the original window.
+ */
+struct tcb_vad_span
+{
+    ma_uint64 start;
+    ma_uint64 length;
+    ma_uint64 packedStart;
+};
+
+struct tcb_vad
+{
+    float *energies;
+    float *sorted;
+    ma_uint64 blockCapacity;
+    tcb_vad_span *spans;
+    ma_uint32 spanCount;
+};
+
+/*
+ * Full-text index of every transcript under ~/.tcb/index. All files are
+ * append-only, so adding a transcript never rewrites what is there:
+ *   docs      one "<first segment> <segment count> <path>" line per recording
+ *   segments  one tcb_index_segment per segment, its id is its position
+ *   text      segment texts back to back
+ *   postings/ INDEX_BUCKETS files of (word hash, segment) pairs, by hash
+ * A search reads one bucket per word, intersects the segment ids and
+ * checks the words against the text. A recording indexed again supersedes
+ * its older entry. tcb_transcript collects the segments of one transcript.
+ */
+struct tcb_index_segment
+{
+    ma_uint32 doc;
+    ma_uint32 textLength;
+    ma_int64 t0Ms;
+    ma_int64 t1Ms;
+    ma_uint64 textOffset;
+};
+
+struct tcb_transcript
+{
+    tcb_index_segment *segments;
+    size_t segmentCount;
+    size_t segmentCapacity;
+    char *text;
+    size_t textLength;
+    size_t textCapacity;
+};
+
+/*
+ * Transcription results under ~/.tcb/cache, one file per key. A key hashes
+ * 16 kHz PCM together with the model and the decoding parameters, see
+ * tcb_cache_key_init, under one of three kinds:
+ *   file    the final transcript of a whole input, times absolute
+ *   chunk   whisper's segments for one chunk's speech, times relative to it
+ *   refine  the beam search result for one low-confidence segment
+ * Segments keep their log-probability, entropy and text tokens, so a hit
+ * is refined and written out exactly like a fresh result. A stream also
+ * collects what it emitted in an entry, which is what the file kind stores.
+ *
+ * Hashing a compressed input means decoding it, so an alias, keyed by the
+ * input's path, size, mtime and inode, records the file key it had. A file
+ * seen before is then found with one stat and no decoding at all.
+ */
+struct tcb_hash
+{
+    ma_uint64 lanes[4];
+    ma_uint8 buffer[32];
+    size_t bufferSize;
+    ma_uint64 totalLength;
+    ma_uint64 seed;
+};
+
+struct tcb_cache_token
+{
+    ma_int32 id;
+    float p;
+    size_t textOffset;
+};
+
+struct tcb_cache_segment
+{
+    ma_int64 t0Ms;
+    ma_int64 t1Ms;
+    float logprob;
+    float entropy;
+    size_t textOffset;
+    size_t tokenOffset;
+    size_t tokenCount;
+};
+
+struct tcb_cache_entry
+{
+    tcb_cache_segment *segments;
+    size_t segmentCount;
+    size_t segmentCapacity;
+    tcb_cache_token *tokens;
+    size_t tokenCount;
+    size_t tokenCapacity;
+    char *text;
+    size_t textLength;
+    size_t textCapacity;
+};
+
+/*
+ * Writes a transcript as it is produced, one segment at a time, in every
+ * format selected in formats (bits of tcb_transcript_format; the text file
+ * is always written): plain text, SRT and WebVTT cues, and JSON lines
+ * with times, text, log-probability and tokens with their probabilities.
+ * The other files share the text file's name with their own extension.
+ */
+struct tcb_transcript_writer
+{
+    ma_uint32 formats;
+    bool timestamps;
+    FILE *files[TCB_TRANSCRIPT_FORMAT_COUNT];
+};
+
+/*
+ * Selects and orders the recordings list-records prints. since and until
+ * are file times, 0 leaves them open, as does a maxDurationMs of 0. A
+ * status of -1 shows every recording.
+ */
+struct tcb_catalog_filter
+{
+    tcb_catalog_sort sort;
+    bool reverse;
+    time_t since;
+    time_t until;
+    ma_uint64 minDurationMs;
+    ma_uint64 maxDurationMs;
+    int status;
+};
+
+/*
+ * Chunked transcriber fed with TARGET_FORMAT frames, either live from the
+ * mixer or block by block from a decoder. Full windows of STREAM_WINDOW_MS
+ * are cut at the quietest point of their last STREAM_SPLIT_SEARCH_MS, so
+ * chunks are independent and can run on several workers at once, each with
+ * its own whisper state. Segments are committed in chunk order. With
+ * maxBufferedFrames set, tcb_stream_push blocks until a worker makes room.
+ * With pFrames set the whole input is given up front and chunks are read
+ * from it in place.
+ *
+ * With refine set and greedy params, segments whose average token
+ * log-probability is below REFINE_LOGPROB_THRESHOLD, or whose last
+ * REFINE_ENTROPY_TOKENS tokens are as repetitive as REFINE_ENTROPY_THRESHOLD
+ * (whisper.cpp's stand-in for the compression ratio), are decoded again
+ * with beam search on a background thread. A better result replaces the
+ * segment and the transcript files are rewritten in place. With cache set,
+ * both chunk and refinement results are looked up in and added to the
+ * transcription cache.
+ */
+struct tcb_stream_config
+{
+    struct whisper_context *whisper;
+    struct whisper_state *state;
+    struct whisper_full_params params;
+    bool refine;
+    bool cache;
+    ma_uint32 workers;
+    const char *pOutputPath;
+    ma_uint32 formats;
+    bool timestamps;
+    bool vad;
+    ma_uint64 maxBufferedFrames;
+    const ma_float *pFrames;
+    ma_uint64 frameCount;
+    tcb_segment_proc onSegment;
+    void *pUserData;
+};
+
+struct tcb_refine_job
+{
+    tcb_refine_job *next;
+    size_t segment;
+    float logprob;
+    bool repetitive;
+    ma_uint64 frameCount;
+    ma_float frames[];
+};
+
+struct tcb_stream_worker
+{
+    tcb_stream *stream;
+    pthread_t thread;
+    struct whisper_state *state;
+    bool ownsState;
+    ma_float *window;
+    tcb_vad vad;
+    tcb_cache_entry result;
+};
+
+struct tcb_stream
+{
+    struct whisper_context *whisper;
+    struct whisper_full_params params;
+    tcb_transcript_writer writer;
+    bool vadEnabled;
+    tcb_segment_proc onSegment;
+    void *pUserData;
+    tcb_stream_worker *workers;
+    ma_uint32 workerCount;
+    const ma_float *source;
+    ma_uint32 threadCount;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_cond_t spaceCond;
+    pthread_cond_t commitCond;
+    ma_float *buffer;
+    ma_uint64 bufferFrames;
+    ma_uint64 bufferCapacity;
+    ma_uint64 bufferStart;
+    ma_uint64 maxBufferedFrames;
+    ma_uint64 windowFrames;
+    ma_uint64 splitSearchFrames;
+    ma_uint64 nextChunk;
+    ma_uint64 committedChunks;
+    ma_uint64 inputFrames;
+    ma_uint64 speechFrames;
+    ma_uint64 heapCalls;
+    ma_uint32 failedChunks;
+    bool finished;
+    pthread_mutex_t outputLock;
+    tcb_transcript transcript;
+    tcb_cache_entry segments;
+    bool cache;
+    bool refine;
+    bool refineStarted;
+    bool refineFinished;
+    pthread_t refineThread;
+    pthread_cond_t refineCond;
+    tcb_refine_job *refineHead;
+    tcb_refine_job *refineTail;
+};
+
+/*
+ * End to end benchmark. Synthetic sources are replayed through the capture
+ * path on miniaudio's null backend: every period is handed to
+ * rb_write_callback as if a device had delivered it, then the real
+ * converter, mixer and writer run on it as fast as the writer keeps up.
+ * With pClipPath set a fixed clip is transcribed afterwards. Results are
+ * printed and, with pJsonPath set, saved as JSON so builds can be compared.
+ */
+struct tcb_bench_config
+{
+    ma_uint32 sourceCount;
+    ma_uint32 seconds;
+    ma_uint32 periodMs;
+    ma_uint32 wakeThresholdMs;
+    tcb_output_format format;
+    tcb_track_mode trackMode;
+    const char *pClipPath;
+    const char *language;
+    bool useGpu;
+    ma_uint32 jobs;
+    const char *pJsonPath;
+};
+
+struct tcb_bench_result
+{
+    ma_uint32 sampleRate;
+    ma_uint32 channels;
+    const char *mixKernel;
+    ma_uint64 framesMixed;
+    ma_uint64 mixCalls;
+    ma_uint64 elapsedNs;
+    ma_uint64 latencyP50Ns;
+    ma_uint64 latencyP90Ns;
+    ma_uint64 latencyP99Ns;
+    ma_uint64 latencyMaxNs;
+    ma_uint64 heapCalls;
+    ma_uint64 droppedFrames;
+    ma_uint64 underrunFrames;
+    ma_uint64 outputBytes;
+    bool transcribed;
+    ma_uint64 clipFrames;
+    ma_uint64 speechFrames;
+    ma_uint64 decodeNs;
+    ma_uint64 modelLoadNs;
+    ma_uint64 transcribeNs;
+    ma_uint64 transcribeHeapCalls;
+    ma_uint32 segments;
+    char text[4096];
+};
+
+/*
+ * Replays sources in real time through the mixer while loadThreads busy
+ * threads compete for the CPUs, once with the mixer at default priority and
+ * once at rtPriority pinned to mixerCpu (-1 leaves it unpinned).
+ */
+struct tcb_load_config
+{
+    ma_uint32 sourceCount;
+    ma_uint32 seconds;
+    ma_uint32 periodMs;
+    ma_uint32 loadThreads;
+    int rtPriority;
+    int mixerCpu;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,198 @@
+#define _GNU_SOURCE
+#include "tcb.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+typedef struct
+{
+    char path[512];
+    ma_uint64 durationMs;
+} tcb_batch_file;
+
+typedef struct
+{
+    struct whisper_context *ctx;
+    const char *language;
+    int threads;
+    tcb_batch_file *files;
+    size_t fileCount;
+    atomic_size_t next;
+    atomic_size_t done;
+    atomic_size_t failed;
+    ma_uint64 startNs;
+    pthread_mutex_t printLock;
+} tcb_batch;
+
+static int tcb_batch_file_compare(const void *a, const void *b)
+{
+    ma_uint64 durationA = ((const tcb_batch_file *)a)->durationMs;
+    ma_uint64 durationB = ((const tcb_batch_file *)b)->durationMs;
+    return (durationA < durationB) - (durationA > durationB);
+}
+
+static size_t tcb_batch_collect(const char *folderPath, tcb_batch_file **pFiles)
+{
+    *pFiles = NULL;
+    DIR *dir = opendir(folderPath);
+    if (dir == NULL)
+    {
+        perror("Failed to open record folder");
+        return 0;
+    }
+
+    size_t count = 0;
+    size_t capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (!tcb_is_record_file(entry->d_name))
+        {
+            continue;
+        }
+
+        char path[512];
+        char transcriptPath[512];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", folderPath, entry->d_name);
+        if (tcb_transcript_path(path, transcriptPath, sizeof(transcriptPath)) != MA_SUCCESS ||
+            stat(transcriptPath, &st) == 0)
+        {
+            continue;
+        }
+
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            tcb_batch_file *files = realloc(*pFiles, capacity * sizeof(tcb_batch_file));
+            if (files == NULL)
+            {
+                break;
+            }
+            *pFiles = files;
+        }
+
+        snprintf((*pFiles)[count].path, sizeof((*pFiles)[count].path), "%s", path);
+        (*pFiles)[count].durationMs = tcb_catalog_probe_duration(path);
+        count++;
+    }
+    closedir(dir);
+
+    /*
+     * Longest first keeps a long file from starting last and running alone.
+     * Duration, not size: an hour of Opus is smaller than minutes of WAV.
+     */
+    qsort(*pFiles, count, sizeof(tcb_batch_file), tcb_batch_file_compare);
+    return count;
+}
+
+static void *tcb_batch_worker(void *arg)
+{
+    tcb_batch *batch = (tcb_batch *)arg;
+    struct whisper_state *state = whisper_init_state(batch->ctx);
+    if (state == NULL)
+    {
+        fprintf(stderr, "Failed to initialize whisper state.\n");
+        return NULL;
+    }
+
+    size_t i;
+    while ((i = atomic_fetch_add(&batch->next, 1)) < batch->fileCount)
+    {
+        struct whisper_full_params params = tcb_whisper_params(batch->language);
+        params.n_threads = batch->threads;
+
+        ma_uint64 start = tcb_time_ns();
+        char outputPath[512];
+        ma_result result = tcb_transcribe_cached(params, 1u << TCB_TRANSCRIPT_TXT, batch->files[i].path, outputPath, sizeof(outputPath), NULL, NULL);
+        if (result != MA_SUCCESS)
+        {
+            result = tcb_transcribe_file(batch->ctx, state, params, 1, true, 1u << TCB_TRANSCRIPT_TXT, batch->files[i].path, outputPath, sizeof(outputPath), NULL, NULL);
+        }
+        size_t done = atomic_fetch_add(&batch->done, 1) + 1;
+        if (result != MA_SUCCESS)
+        {
+            atomic_fetch_add(&batch->failed, 1);
+        }
+
+        pthread_mutex_lock(&batch->printLock);
+        printf("[%zu/%zu] %s %s (%.1f s, %.0f s elapsed)\n",
+               done,
+               batch->fileCount,
+               result == MA_SUCCESS ? "done" : "FAILED",
+               batch->files[i].path,
+               (double)(tcb_time_ns() - start) / 1e9,
+               (double)(tcb_time_ns() - batch->startNs) / 1e9);
+        fflush(stdout);
+        pthread_mutex_unlock(&batch->printLock);
+    }
+
+    whisper_free_state(state);
+    return NULL;
+}
+
+int tcb_transcribe_all(const char *language, bool use_gpu, int jobs, int threads)
+{
+    char *home = getenv("HOME");
+    char folderPath[512];
+    snprintf(folderPath, sizeof(folderPath), "%s/%s", home, RECORD_FOLDER);
+
+    tcb_batch batch;
+    batch.fileCount = tcb_batch_collect(folderPath, &batch.files);
+    if (batch.fileCount == 0)
+    {
+        printf("Nothing to transcribe.\n");
+        free(batch.files);
+        return 0;
+    }
+
+    jobs = (int)ma_min((size_t)ma_max(jobs, 1), batch.fileCount);
+    printf("Transcribing %zu files with %d jobs x %d threads\n", batch.fileCount, jobs, threads);
+
+    batch.ctx = tcb_whisper_init_shared(use_gpu);
+    if (!batch.ctx)
+    {
+        free(batch.files);
+        return -1;
+    }
+
+    batch.language = language;
+    batch.threads = threads;
+    atomic_init(&batch.next, 0);
+    atomic_init(&batch.done, 0);
+    atomic_init(&batch.failed, 0);
+    batch.startNs = tcb_time_ns();
+    pthread_mutex_init(&batch.printLock, NULL);
+
+    pthread_t *workers = malloc(jobs * sizeof(pthread_t));
+    int started = 0;
+    for (int i = 0; workers != NULL && i < jobs; i++)
+    {
+        if (pthread_create(&workers[i], NULL, tcb_batch_worker, &batch) != 0)
+        {
+            fprintf(stderr, "Failed to start worker %d.\n", i);
+            break;
+        }
+        started++;
+    }
+
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+
+    size_t failed = atomic_load(&batch.failed) + (batch.fileCount - ma_min(atomic_load(&batch.done), batch.fileCount));
+    printf("Transcribed %zu of %zu files in %.1f s\n",
+           batch.fileCount - failed,
+           batch.fileCount,
+           (double)(tcb_time_ns() - batch.startNs) / 1e9);
+
+    pthread_mutex_destroy(&batch.printLock);
+    free(workers);
+    free(batch.files);
+    whisper_free(batch.ctx);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,822 @@
+#define _GNU_SOURCE
+#include "tcb.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+tcb_bench_config tcb_bench_config_init(void)
+{
+    tcb_bench_config config;
+    config.sourceCount = 2;
+    config.seconds = BENCH_SECONDS;
+    config.periodMs = BENCH_PERIOD_MS;
+    config.wakeThresholdMs = MIXER_WAKE_THRESHOLD_MS;
+    config.format = TCB_FORMAT_WAV;
+    config.trackMode = TCB_TRACKS_NONE;
+    config.pClipPath = NULL;
+    config.language = "en";
+    config.useGpu = false;
+    config.jobs = 1;
+    config.pJsonPath = NULL;
+
+    return config;
+}
+
+static int tcb_bench_compare(const void *a, const void *b)
+{
+    ma_uint64 x = *(const ma_uint64 *)a;
+    ma_uint64 y = *(const ma_uint64 *)b;
+    return (x > y) - (x < y);
+}
+
+static ma_uint64 tcb_bench_percentile(const ma_uint64 *sorted, ma_uint64 count, ma_uint32 percentile)
+{
+    return count > 0 ? sorted[(count - 1) * percentile / 100] : 0;
+}
+
+static void tcb_bench_remove_directory(const char *pDirectory)
+{
+    DIR *dir = opendir(pDirectory);
+    if (dir != NULL)
+    {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL)
+        {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            {
+                continue;
+            }
+
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/%s", pDirectory, entry->d_name);
+            unlink(path);
+        }
+        closedir(dir);
+    }
+    rmdir(pDirectory);
+}
+
+/*
+ * One second of a distinct tone per source in the device's own format,
+ * followed by a copy of its first period so any period can be read from it
+ * without wrapping.
+ */
+static void *tcb_bench_make_source(ma_uint32 source, ma_format format, ma_uint32 channels, ma_uint32 sampleRate, ma_uint32 periodFrames)
+{
+    ma_uint64 frameCount = (ma_uint64)sampleRate + periodFrames;
+    float *samples = malloc(frameCount * channels * sizeof(float));
+    void *frames = malloc(frameCount * ma_get_bytes_per_frame(format, channels));
+    if (samples == NULL || frames == NULL)
+    {
+        free(samples);
+        free(frames);
+        return NULL;
+    }
+
+    float frequency = 220.0f * (source + 1);
+    for (ma_uint64 i = 0; i < frameCount; i++)
+    {
+        float sample = 0.25f * sinf(2.0f * (float)M_PI * frequency * (float)(i % sampleRate) / sampleRate);
+        for (ma_uint32 c = 0; c < channels; c++)
+        {
+            samples[i * channels + c] = sample;
+        }
+    }
+
+    ma_pcm_convert(frames, format, samples, ma_format_f32, frameCount * channels, ma_dither_mode_none);
+    free(samples);
+    return frames;
+}
+
+/* Opens sourceCount capture devices on miniaudio's null backend, their periods are fed by hand. */
+static ma_result tcb_bench_context_init(ma_context *pMaContext, tcb_context *context, tcb_context_config *contextConfig, ma_uint32 sourceCount, const char *pFilePath)
+{
+    ma_backend backends[] = {ma_backend_null};
+    if (ma_context_init(backends, 1, NULL, pMaContext) != MA_SUCCESS)
+    {
+        fprintf(stderr, "Failed to initialize null audio backend.\n");
+        return MA_ERROR;
+    }
+
+    ma_device_info *pPlaybackDeviceInfos;
+    ma_uint32 playbackDeviceCount;
+    ma_device_info *pCaptureDeviceInfos;
+    ma_uint32 captureDeviceCount;
+    if (ma_context_get_devices(pMaContext, &pPlaybackDeviceInfos, &playbackDeviceCount, &pCaptureDeviceInfos, &captureDeviceCount) != MA_SUCCESS || captureDeviceCount == 0)
+    {
+        fprintf(stderr, "Failed to find a null capture device.\n");
+        ma_context_uninit(pMaContext);
+        return MA_ERROR;
+    }
+
+    /* Every source is its own device on the same null endpoint. */
+    ma_device_id *deviceIds = malloc(sourceCount * sizeof(ma_device_id));
+    if (deviceIds == NULL)
+    {
+        fprintf(stderr, "Failed to allocate memory for devices.\n");
+        ma_context_uninit(pMaContext);
+        return MA_OUT_OF_MEMORY;
+    }
+    for (ma_uint32 i = 0; i < sourceCount; i++)
+    {
+        deviceIds[i] = pCaptureDeviceInfos[0].id;
+    }
+
+    contextConfig->pContext = pMaContext;
+    ma_result result = tcb_context_init(context, contextConfig, pFilePath, deviceIds, sourceCount);
+    free(deviceIds);
+    if (result != MA_SUCCESS)
+    {
+        ma_context_uninit(pMaContext);
+    }
+
+    return result;
+}
+
+static ma_result tcb_bench_pipeline(const tcb_bench_config *config, const char *pDirectory, tcb_bench_result *result)
+{
+    char filePath[512];
+    snprintf(filePath, sizeof(filePath), "%s/bench.%s", pDirectory, tcb_output_format_extension(config->format));
+
+    tcb_context_config contextConfig = tcb_context_config_init();
+    contextConfig.wakeThresholdMs = config->wakeThresholdMs;
+    contextConfig.format = config->format;
+    contextConfig.trackMode = config->trackMode;
+
+    ma_context maContext;
+    tcb_context context;
+    ma_result initResult = tcb_bench_context_init(&maContext, &context, &contextConfig, config->sourceCount, filePath);
+    if (initResult != MA_SUCCESS)
+    {
+        return initResult;
+    }
+
+    ma_device *device = &context.devices[0].device;
+    ma_uint32 sampleRate = device->sampleRate;
+    ma_uint32 bytesPerFrame = ma_get_bytes_per_frame(device->capture.format, device->capture.channels);
+    ma_uint32 periodFrames = ma_max(1, sampleRate * config->periodMs / 1000);
+    ma_uint32 periodsPerMix = ma_max(1, config->wakeThresholdMs / ma_max(1, config->periodMs));
+    ma_uint64 totalFrames = (ma_uint64)config->seconds * sampleRate;
+    ma_uint64 maxMixCalls = totalFrames / periodFrames / periodsPerMix + 2;
+
+    /* What one mix may hand the writer, rounded up for the resampler. */
+    ma_uint32 mixFrames = (ma_uint32)((ma_uint64)periodFrames * periodsPerMix * TARGET_SAMPLE_RATE / sampleRate) + 1;
+
+    void **sources = calloc(config->sourceCount, sizeof(void *));
+    ma_uint64 *latencies = malloc(maxMixCalls * sizeof(ma_uint64));
+    bool ready = sources != NULL && latencies != NULL;
+    for (ma_uint32 i = 0; ready && i < config->sourceCount; i++)
+    {
+        sources[i] = tcb_bench_make_source(i, device->capture.format, device->capture.channels, sampleRate, periodFrames);
+        ready = sources[i] != NULL;
+    }
+
+    ma_result pipelineResult = MA_ERROR;
+    if (!ready)
+    {
+        fprintf(stderr, "Failed to allocate benchmark sources.\n");
+    }
+    else if (tcb_writer_start(&context.writer) == MA_SUCCESS)
+    {
+        result->sampleRate = sampleRate;
+        result->channels = device->capture.channels;
+        result->mixKernel = context.mixKernel->name;
+
+        ma_uint64 heapCallsStart = tcb_context_heap_calls(&context);
+        ma_uint64 startNs = tcb_time_ns();
+        context.startNs = startNs;
+        ma_uint64 position = 0;
+        ma_uint64 period = 0;
+        while (position < totalFrames)
+        {
+            for (ma_uint32 d = 0; d < context.deviceCount; d++)
+            {
+                const ma_uint8 *pInput = (const ma_uint8 *)sources[d] + (position % sampleRate) * bytesPerFrame;
+                rb_write_callback(&context.devices[d].device, NULL, pInput, periodFrames);
+            }
+            position += periodFrames;
+
+            if (++period % periodsPerMix != 0 && position < totalFrames)
+            {
+                continue;
+            }
+
+            /* A recording host drains in real time, here the writer sets the pace instead of dropping frames. */
+            while (tcb_writer_available_frames(&context.writer) < mixFrames)
+            {
+                struct timespec ts = {0, 200000};
+                nanosleep(&ts, NULL);
+            }
+
+            ma_uint64 mixStartNs = tcb_time_ns();
+            result->framesMixed += tcb_context_mix(&context);
+            if (result->mixCalls < maxMixCalls)
+            {
+                latencies[result->mixCalls++] = tcb_time_ns() - mixStartNs;
+            }
+        }
+
+        result->heapCalls = tcb_context_heap_calls(&context) - heapCallsStart;
+
+        /* The run ends once everything is on disk. */
+        tcb_writer_stop(&context.writer);
+        result->elapsedNs = tcb_time_ns() - startNs;
+
+        qsort(latencies, result->mixCalls, sizeof(ma_uint64), tcb_bench_compare);
+        result->latencyP50Ns = tcb_bench_percentile(latencies, result->mixCalls, 50);
+        result->latencyP90Ns = tcb_bench_percentile(latencies, result->mixCalls, 90);
+        result->latencyP99Ns = tcb_bench_percentile(latencies, result->mixCalls, 99);
+        result->latencyMaxNs = tcb_bench_percentile(latencies, result->mixCalls, 100);
+        result->droppedFrames = tcb_writer_dropped_frames(&context.writer);
+        for (ma_uint32 d = 0; d < context.deviceCount; d++)
+        {
+            result->droppedFrames += atomic_load(&context.devices[d].stats.framesDropped);
+            result->underrunFrames += atomic_load(&context.devices[d].stats.underrunFrames);
+        }
+        tcb_context_report_errors(&context);
+        pipelineResult = MA_SUCCESS;
+    }
+
+    for (ma_uint32 i = 0; sources != NULL && i < config->sourceCount; i++)
+    {
+        free(sources[i]);
+    }
+    free(sources);
+    free(latencies);
+    tcb_context_uninit(&context);
+    ma_context_uninit(&maContext);
+
+    struct stat st;
+    if (pipelineResult == MA_SUCCESS && stat(filePath, &st) == 0)
+    {
+        result->outputBytes = (ma_uint64)st.st_size;
+    }
+
+    return pipelineResult;
+}
+
+static void tcb_bench_collect_segment(void *pUserData, ma_int64 t0Ms, ma_int64 t1Ms, const char *text)
+{
+    tcb_bench_result *result = (tcb_bench_result *)pUserData;
+    size_t length = strlen(result->text);
+    snprintf(result->text + length, sizeof(result->text) - length, "%s", text);
+    result->segments++;
+    (void)t0Ms;
+    (void)t1Ms;
+}
+
+static ma_result tcb_bench_transcription(const tcb_bench_config *config, const char *pDirectory, tcb_bench_result *result)
+{
+    /* The clip is decoded up front so only whisper is on the clock. */
+    ma_uint64 decodeStartNs = tcb_time_ns();
+    tcb_reader reader;
+    if (tcb_reader_init(&reader, config->pClipPath) != MA_SUCCESS)
+    {
+        return MA_ERROR;
+    }
+
+    ma_uint64 capacity = 0;
+    ma_float *frames = NULL;
+    while (1)
+    {
+        if (result->clipFrames + DECODE_BLOCK_FRAMES > capacity)
+        {
+            capacity = ma_max(capacity * 2, DECODE_BLOCK_FRAMES);
+            ma_float *grown = realloc(frames, capacity * sizeof(ma_float));
+            if (grown == NULL)
+            {
+                fprintf(stderr, "Failed to allocate memory for audio data.\n");
+                free(frames);
+                tcb_reader_uninit(&reader);
+                return MA_OUT_OF_MEMORY;
+            }
+            frames = grown;
+        }
+
+        ma_uint64 framesRead = 0;
+        ma_result readResult = tcb_reader_read(&reader, frames + result->clipFrames, DECODE_BLOCK_FRAMES, &framesRead);
+        result->clipFrames += framesRead;
+        if (readResult != MA_SUCCESS || framesRead < DECODE_BLOCK_FRAMES)
+        {
+            break;
+        }
+    }
+    tcb_reader_uninit(&reader);
+    result->decodeNs = tcb_time_ns() - decodeStartNs;
+
+    if (result->clipFrames == 0)
+    {
+        fprintf(stderr, "Benchmark clip is empty: %s\n", config->pClipPath);
+        free(frames);
+        return MA_ERROR;
+    }
+
+    ma_uint64 loadStartNs = tcb_time_ns();
+    struct whisper_context *whisper = config->jobs > 1 ? tcb_whisper_init_shared(config->useGpu) : tcb_whisper_init(config->useGpu);
+    result->modelLoadNs = tcb_time_ns() - loadStartNs;
+    if (whisper == NULL)
+    {
+        free(frames);
+        return MA_ERROR;
+    }
+
+    char outputPath[512];
+    snprintf(outputPath, sizeof(outputPath), "%s/clip.txt", pDirectory);
+    struct whisper_full_params params = tcb_whisper_params(config->language);
+    params.n_threads = (int)ma_max(1, tcb_cpu_cores() / config->jobs);
+
+    tcb_stream_config streamConfig = tcb_stream_config_init(whisper, params, outputPath);
+    streamConfig.workers = config->jobs;
+    streamConfig.cache = false;
+    streamConfig.pFrames = frames;
+    streamConfig.frameCount = result->clipFrames;
+    streamConfig.onSegment = tcb_bench_collect_segment;
+    streamConfig.pUserData = result;
+
+    ma_uint64 startNs = tcb_time_ns();
+    tcb_stream stream;
+    ma_result transcribeResult = tcb_stream_init(&stream, &streamConfig);
+    if (transcribeResult == MA_SUCCESS)
+    {
+        tcb_stream_finish(&stream);
+        result->transcribeNs = tcb_time_ns() - startNs;
+        result->speechFrames = stream.speechFrames;
+        result->transcribeHeapCalls = stream.heapCalls;
+        result->transcribed = stream.failedChunks == 0;
+        transcribeResult = result->transcribed ? MA_SUCCESS : MA_ERROR;
+        tcb_stream_uninit(&stream);
+    }
+
+    whisper_free(whisper);
+    free(frames);
+    return transcribeResult;
+}
+
+static void tcb_bench_write_string(FILE *file, const char *text)
+{
+    fputc('"', file);
+    for (const unsigned char *p = (const unsigned char *)text; *p != '\0'; p++)
+    {
+        if (*p == '"' || *p == '\\')
+        {
+            fprintf(file, "\\%c", *p);
+        }
+        else if (*p < 0x20)
+        {
+            fprintf(file, "\\u%04x", *p);
+        }
+        else
+        {
+            fputc(*p, file);
+        }
+    }
+    fputc('"', file);
+}
+
+static ma_result tcb_bench_write_json(const tcb_bench_config *config, const tcb_bench_result *result, const char *pFilePath)
+{
+    FILE *file = fopen(pFilePath, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open benchmark file: %s\n", pFilePath);
+        return MA_ERROR;
+    }
+
+    double audioSeconds = (double)result->framesMixed / TARGET_SAMPLE_RATE;
+    double elapsedSeconds = (double)result->elapsedNs / 1e9;
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"pipeline\": {\n");
+    fprintf(file, "    \"sources\": %u,\n", config->sourceCount);
+    fprintf(file, "    \"sample_rate\": %u,\n", result->sampleRate);
+    fprintf(file, "    \"channels\": %u,\n", result->channels);
+    fprintf(file, "    \"period_ms\": %u,\n", config->periodMs);
+    fprintf(file, "    \"wake_ms\": %u,\n", config->wakeThresholdMs);
+    fprintf(file, "    \"format\": \"%s\",\n", tcb_output_format_extension(config->format));
+    fprintf(file, "    \"kernel\": \"%s\",\n", result->mixKernel);
+    fprintf(file, "    \"audio_seconds\": %.3f,\n", audioSeconds);
+    fprintf(file, "    \"elapsed_ms\": %.3f,\n", elapsedSeconds * 1000.0);
+    fprintf(file, "    \"frames_per_second\": %.1f,\n", elapsedSeconds > 0.0 ? result->framesMixed / elapsedSeconds : 0.0);
+    fprintf(file, "    \"realtime_factor\": %.6f,\n", audioSeconds > 0.0 ? elapsedSeconds / audioSeconds : 0.0);
+    fprintf(file, "    \"mix_calls\": %llu,\n", (unsigned long long)result->mixCalls);
+    fprintf(file, "    \"latency_p50_ms\": %.4f,\n", (double)result->latencyP50Ns / 1e6);
+    fprintf(file, "    \"latency_p90_ms\": %.4f,\n", (double)result->latencyP90Ns / 1e6);
+    fprintf(file, "    \"latency_p99_ms\": %.4f,\n", (double)result->latencyP99Ns / 1e6);
+    fprintf(file, "    \"latency_max_ms\": %.4f,\n", (double)result->latencyMaxNs / 1e6);
+    fprintf(file, "    \"heap_calls\": %llu,\n", (unsigned long long)result->heapCalls);
+    fprintf(file, "    \"dropped_frames\": %llu,\n", (unsigned long long)result->droppedFrames);
+    fprintf(file, "    \"underrun_frames\": %llu,\n", (unsigned long long)result->underrunFrames);
+    fprintf(file, "    \"output_bytes\": %llu\n", (unsigned long long)result->outputBytes);
+    fprintf(file, "  },\n");
+
+    if (!result->transcribed)
+    {
+        fprintf(file, "  \"transcription\": null\n");
+    }
+    else
+    {
+        double clipSeconds = (double)result->clipFrames / TARGET_SAMPLE_RATE;
+        double transcribeSeconds = (double)result->transcribeNs / 1e9;
+
+        fprintf(file, "  \"transcription\": {\n");
+        fprintf(file, "    \"clip\": ");
+        tcb_bench_write_string(file, config->pClipPath);
+        fprintf(file, ",\n");
+        fprintf(file, "    \"jobs\": %u,\n", config->jobs);
+        fprintf(file, "    \"gpu\": %s,\n", config->useGpu ? "true" : "false");
+        fprintf(file, "    \"threads\": %u,\n", ma_max(1, tcb_cpu_cores() / config->jobs));
+        fprintf(file, "    \"system_info\": ");
+        tcb_bench_write_string(file, whisper_print_system_info());
+        fprintf(file, ",\n");
+        fprintf(file, "    \"audio_seconds\": %.3f,\n", clipSeconds);
+        fprintf(file, "    \"speech_seconds\": %.3f,\n", (double)result->speechFrames / TARGET_SAMPLE_RATE);
+        fprintf(file, "    \"decode_ms\": %.3f,\n", (double)result->decodeNs / 1e6);
+        fprintf(file, "    \"model_load_ms\": %.3f,\n", (double)result->modelLoadNs / 1e6);
+        fprintf(file, "    \"elapsed_ms\": %.3f,\n", transcribeSeconds * 1000.0);
+        fprintf(file, "    \"realtime_factor\": %.6f,\n", transcribeSeconds / clipSeconds);
+        fprintf(file, "    \"segments\": %u,\n", result->segments);
+        fprintf(file, "    \"heap_calls\": %llu,\n", (unsigned long long)result->transcribeHeapCalls);
+        fprintf(file, "    \"text\": ");
+        tcb_bench_write_string(file, result->text);
+        fprintf(file, "\n");
+        fprintf(file, "  }\n");
+    }
+    fprintf(file, "}\n");
+
+    fclose(file);
+    return MA_SUCCESS;
+}
+
+int tcb_bench(const tcb_bench_config *config)
+{
+    if (config->sourceCount == 0 || config->seconds == 0)
+    {
+        fprintf(stderr, "Specify a positive number of sources and seconds.\n");
+        return -1;
+    }
+
+    char directory[] = "/tmp/tcb-bench-XXXXXX";
+    if (mkdtemp(directory) == NULL)
+    {
+        fprintf(stderr, "Failed to create benchmark folder.\n");
+        return -1;
+    }
+
+    tcb_bench_result *result = calloc(1, sizeof(tcb_bench_result));
+    if (result == NULL)
+    {
+        fprintf(stderr, "Failed to allocate benchmark results.\n");
+        tcb_bench_remove_directory(directory);
+        return -1;
+    }
+
+    int failures = 0;
+    printf("Replaying %u sources x %u s through the capture pipeline (%s)\n",
+           config->sourceCount, config->seconds, tcb_output_format_extension(config->format));
+    if (tcb_bench_pipeline(config, directory, result) == MA_SUCCESS)
+    {
+        double audioSeconds = (double)result->framesMixed / TARGET_SAMPLE_RATE;
+        double elapsedSeconds = (double)result->elapsedNs / 1e9;
+        printf("    %.1f frames/s, %.0fx real time, %llu mixes\n",
+               elapsedSeconds > 0.0 ? result->framesMixed / elapsedSeconds : 0.0,
+               elapsedSeconds > 0.0 ? audioSeconds / elapsedSeconds : 0.0,
+               (unsigned long long)result->mixCalls);
+        printf("    mix latency p50 %.3f ms p90 %.3f ms p99 %.3f ms max %.3f ms\n",
+               (double)result->latencyP50Ns / 1e6,
+               (double)result->latencyP90Ns / 1e6,
+               (double)result->latencyP99Ns / 1e6,
+               (double)result->latencyMaxNs / 1e6);
+        printf("    heap calls %llu, dropped %llu, underrun %llu\n",
+               (unsigned long long)result->heapCalls,
+               (unsigned long long)result->droppedFrames,
+               (unsigned long long)result->underrunFrames);
+    }
+    else
+    {
+        failures++;
+    }
+
+    if (config->pClipPath != NULL)
+    {
+        printf("Transcribing %s\n", config->pClipPath);
+        if (tcb_bench_transcription(config, directory, result) == MA_SUCCESS)
+        {
+            printf("    %.2f s of audio in %.2f s, real time factor %.3f, %u segments\n",
+                   (double)result->clipFrames / TARGET_SAMPLE_RATE,
+                   (double)result->transcribeNs / 1e9,
+                   (double)result->transcribeNs / 1e9 / ((double)result->clipFrames / TARGET_SAMPLE_RATE),
+                   result->segments);
+        }
+        else
+        {
+            failures++;
+        }
+    }
+
+    if (config->pJsonPath != NULL)
+    {
+        if (tcb_bench_write_json(config, result, config->pJsonPath) == MA_SUCCESS)
+        {
+            printf("Benchmark saved to: %s\n", config->pJsonPath);
+        }
+        else
+        {
+            failures++;
+        }
+    }
+
+    free(result);
+    tcb_bench_remove_directory(directory);
+    return failures;
+}
+
+tcb_load_config tcb_load_config_init(void)
+{
+    tcb_load_config config;
+    config.sourceCount = 2;
+    config.seconds = LOAD_TEST_SECONDS;
+    config.periodMs = BENCH_PERIOD_MS;
+    config.loadThreads = 0;
+    config.rtPriority = MIXER_RT_PRIORITY;
+    config.mixerCpu = -1;
+
+    return config;
+}
+
+typedef struct
+{
+    tcb_context *context;
+    void **sources;
+    ma_uint32 sampleRate;
+    ma_uint32 bytesPerFrame;
+    ma_uint32 periodFrames;
+    ma_uint64 totalFrames;
+    ma_uint64 overruns;
+    ma_uint64 lateCallbacks;
+    ma_uint64 lateMaxNs;
+} tcb_load_driver;
+
+typedef struct
+{
+    bool driverRealtime;
+    bool mixerRealtime;
+    ma_uint64 overruns;
+    ma_uint64 lateCallbacks;
+    ma_uint64 lateMaxNs;
+    ma_uint64 droppedFrames;
+    ma_uint64 underrunFrames;
+    ma_uint64 writerDroppedFrames;
+    ma_uint64 wakeLatencyAvgNs;
+    ma_uint64 wakeLatencyMaxNs;
+} tcb_load_result;
+
+/* Walks a buffer larger than most caches so the load also competes for memory bandwidth. */
+static void *tcb_load_stress_thread(void *arg)
+{
+    atomic_bool *running = (atomic_bool *)arg;
+    ma_uint8 *buffer = calloc(LOAD_TEST_BUFFER_BYTES, 1);
+    ma_uint8 value = 0;
+    while (atomic_load_explicit(running, memory_order_relaxed))
+    {
+        for (size_t i = 0; buffer != NULL && i < LOAD_TEST_BUFFER_BYTES; i += 64)
+        {
+            buffer[i] += value++;
+        }
+    }
+
+    free(buffer);
+    return NULL;
+}
+
+/*
+ * Stands in for the audio server: delivers one period per source on a fixed
+ * schedule. A callback more than a period late is what a device would have
+ * overrun on, one that finds the ring full is an overrun the mixer caused.
+ */
+static void *tcb_load_driver_thread(void *arg)
+{
+    tcb_load_driver *driver = (tcb_load_driver *)arg;
+    tcb_context *context = driver->context;
+    ma_uint64 periodNs = (ma_uint64)driver->periodFrames * 1000000000ull / driver->sampleRate;
+    ma_uint64 deadlineNs = tcb_time_ns();
+
+    for (ma_uint64 position = 0; position < driver->totalFrames; position += driver->periodFrames)
+    {
+        deadlineNs += periodNs;
+        struct timespec deadline = {(time_t)(deadlineNs / 1000000000ull), (long)(deadlineNs % 1000000000ull)};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+        {
+        }
+
+        ma_uint64 lateNs = tcb_time_ns() - deadlineNs;
+        driver->lateMaxNs = ma_max(driver->lateMaxNs, lateNs);
+        driver->lateCallbacks += lateNs > periodNs ? 1 : 0;
+
+        for (ma_uint32 d = 0; d < context->deviceCount; d++)
+        {
+            ma_uint64 dropped = atomic_load_explicit(&context->devices[d].stats.framesDropped, memory_order_relaxed);
+            const ma_uint8 *pInput = (const ma_uint8 *)driver->sources[d] + (position % driver->sampleRate) * driver->bytesPerFrame;
+            rb_write_callback(&context->devices[d].device, NULL, pInput, driver->periodFrames);
+            driver->overruns += atomic_load_explicit(&context->devices[d].stats.framesDropped, memory_order_relaxed) != dropped ? 1 : 0;
+        }
+    }
+
+    return NULL;
+}
+
+static ma_result tcb_load_phase(const tcb_load_config *config, const char *pDirectory, int mixerPriority, int mixerCpu, tcb_load_result *result)
+{
+    char filePath[512];
+    snprintf(filePath, sizeof(filePath), "%s/load.wav", pDirectory);
+
+    tcb_context_config contextConfig = tcb_context_config_init();
+    contextConfig.mixerPriority = mixerPriority;
+    contextConfig.mixerCpu = mixerCpu;
+
+    ma_context maContext;
+    tcb_context context;
+    ma_result phaseResult = tcb_bench_context_init(&maContext, &context, &contextConfig, config->sourceCount, filePath);
+    if (phaseResult != MA_SUCCESS)
+    {
+        return phaseResult;
+    }
+
+    ma_device *device = &context.devices[0].device;
+    tcb_load_driver driver;
+    memset(&driver, 0, sizeof(driver));
+    driver.context = &context;
+    driver.sampleRate = device->sampleRate;
+    driver.bytesPerFrame = ma_get_bytes_per_frame(device->capture.format, device->capture.channels);
+    driver.periodFrames = ma_max(1, device->sampleRate * config->periodMs / 1000);
+    driver.totalFrames = (ma_uint64)config->seconds * device->sampleRate;
+    driver.sources = calloc(config->sourceCount, sizeof(void *));
+
+    bool ready = driver.sources != NULL;
+    for (ma_uint32 i = 0; ready && i < config->sourceCount; i++)
+    {
+        driver.sources[i] = tcb_bench_make_source(i, device->capture.format, device->capture.channels, device->sampleRate, driver.periodFrames);
+        ready = driver.sources[i] != NULL;
+    }
+
+    phaseResult = MA_ERROR;
+    if (!ready)
+    {
+        fprintf(stderr, "Failed to allocate benchmark sources.\n");
+    }
+    else if (tcb_context_start_mixer(&context) == MA_SUCCESS)
+    {
+        int policy;
+        struct sched_param param;
+        result->mixerRealtime = pthread_getschedparam(context.thread, &policy, &param) == 0 && policy == SCHED_FIFO;
+
+        /* Audio servers run their callbacks real-time, the stand-in does too where it may. */
+        pthread_t driverThread;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+        param.sched_priority = ma_min(ma_max(config->rtPriority, mixerPriority) + 1, sched_get_priority_max(SCHED_FIFO));
+        pthread_attr_setschedparam(&attr, &param);
+        result->driverRealtime = config->rtPriority > 0 && pthread_create(&driverThread, &attr, tcb_load_driver_thread, &driver) == 0;
+        pthread_attr_destroy(&attr);
+
+        if (result->driverRealtime || pthread_create(&driverThread, NULL, tcb_load_driver_thread, &driver) == 0)
+        {
+            pthread_join(driverThread, NULL);
+            phaseResult = MA_SUCCESS;
+        }
+        else
+        {
+            fprintf(stderr, "Failed to start capture thread.\n");
+        }
+        tcb_context_stop_mixer(&context);
+
+        result->overruns = driver.overruns;
+        result->lateCallbacks = driver.lateCallbacks;
+        result->lateMaxNs = driver.lateMaxNs;
+        result->writerDroppedFrames = tcb_writer_dropped_frames(&context.writer);
+        result->wakeLatencyAvgNs = context.mixLatencyCount > 0 ? context.mixLatencyTotalNs / context.mixLatencyCount : 0;
+        result->wakeLatencyMaxNs = context.mixLatencyMaxNs;
+        for (ma_uint32 d = 0; d < context.deviceCount; d++)
+        {
+            result->droppedFrames += atomic_load(&context.devices[d].stats.framesDropped);
+            result->underrunFrames += atomic_load(&context.devices[d].stats.underrunFrames);
+        }
+    }
+
+    for (ma_uint32 i = 0; driver.sources != NULL && i < config->sourceCount; i++)
+    {
+        free(driver.sources[i]);
+    }
+    free(driver.sources);
+    tcb_context_uninit(&context);
+    ma_context_uninit(&maContext);
+    unlink(filePath);
+
+    return phaseResult;
+}
+
+static void tcb_load_print(const char *pName, const tcb_load_result *result)
+{
+    printf("%s\n", pName);
+    printf("    xruns %llu: %llu overruns (%llu frames dropped), %llu late callbacks\n",
+           (unsigned long long)(result->overruns + result->lateCallbacks),
+           (unsigned long long)result->overruns,
+           (unsigned long long)result->droppedFrames,
+           (unsigned long long)result->lateCallbacks);
+    printf("    mixer wake latency avg %.2f ms max %.2f ms, callback late max %.2f ms\n",
+           (double)result->wakeLatencyAvgNs / 1e6,
+           (double)result->wakeLatencyMaxNs / 1e6,
+           (double)result->lateMaxNs / 1e6);
+    printf("    underrun %llu, writer dropped %llu\n",
+           (unsigned long long)result->underrunFrames,
+           (unsigned long long)result->writerDroppedFrames);
+}
+
+int tcb_load_test(const tcb_load_config *config)
+{
+    if (config->sourceCount == 0 || config->seconds == 0)
+    {
+        fprintf(stderr, "Specify a positive number of sources and seconds.\n");
+        return -1;
+    }
+
+    char directory[] = "/tmp/tcb-load-XXXXXX";
+    if (mkdtemp(directory) == NULL)
+    {
+        fprintf(stderr, "Failed to create benchmark folder.\n");
+        return -1;
+    }
+
+    ma_uint32 loadThreads = config->loadThreads > 0 ? config->loadThreads : (ma_uint32)ma_max(1, sysconf(_SC_NPROCESSORS_ONLN));
+    pthread_t *stressors = calloc(loadThreads, sizeof(pthread_t));
+    if (stressors == NULL)
+    {
+        fprintf(stderr, "Failed to allocate load threads.\n");
+        rmdir(directory);
+        return -1;
+    }
+
+    /* Both phases run under the same load, started once before the first. */
+    atomic_bool running;
+    atomic_init(&running, true);
+    ma_uint32 started = 0;
+    while (started < loadThreads && pthread_create(&stressors[started], NULL, tcb_load_stress_thread, &running) == 0)
+    {
+        started++;
+    }
+
+    printf("Load test: %u sources x %u s, %u ms periods, %u busy threads\n", config->sourceCount, config->seconds, config->periodMs, started);
+
+    int failures = 0;
+    tcb_load_result results[2];
+    memset(results, 0, sizeof(results));
+    if (tcb_load_phase(config, directory, 0, -1, &results[0]) != MA_SUCCESS)
+    {
+        failures++;
+    }
+    if (tcb_load_phase(config, directory, config->rtPriority, config->mixerCpu, &results[1]) != MA_SUCCESS)
+    {
+        failures++;
+    }
+
+    atomic_store(&running, false);
+    for (ma_uint32 i = 0; i < started; i++)
+    {
+        pthread_join(stressors[i], NULL);
+    }
+    free(stressors);
+    rmdir(directory);
+
+    if (failures == 0)
+    {
+        printf("Capture thread: %s\n", results[0].driverRealtime ? "SCHED_FIFO" : "default priority");
+        tcb_load_print("Mixer at default priority", &results[0]);
+
+        char name[128];
+        if (results[1].mixerRealtime)
+        {
+            snprintf(name, sizeof(name), "Mixer at SCHED_FIFO %d", config->rtPriority);
+        }
+        else
+        {
+            snprintf(name, sizeof(name), "Mixer at default priority%s", config->rtPriority > 0 ? " (real-time not permitted)" : "");
+        }
+        if (config->mixerCpu >= 0)
+        {
+            size_t length = strlen(name);
+            snprintf(name + length, sizeof(name) - length, " on CPU %d", config->mixerCpu);
+        }
+        tcb_load_print(name, &results[1]);
+    }
+
+    return failures;
+}
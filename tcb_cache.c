@@ -0,0 +1,612 @@
+#define _GNU_SOURCE
+#include "whisper.h"
+#include "tcb.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define HASH_PRIME1 0x9E3779B185EBCA87ull
+#define HASH_PRIME2 0xC2B2AE3D27D4EB4Full
+#define HASH_PRIME3 0x165667B19E3779F9ull
+#define HASH_PRIME4 0x85EBCA77C2B2AE63ull
+#define HASH_PRIME5 0x27D4EB2F165667C5ull
+
+static ma_uint64 tcb_hash_rotl(ma_uint64 x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static ma_uint64 tcb_hash_read64(const ma_uint8 *p)
+{
+    ma_uint64 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static ma_uint64 tcb_hash_round(ma_uint64 acc, ma_uint64 input)
+{
+    acc += input * HASH_PRIME2;
+    return tcb_hash_rotl(acc, 31) * HASH_PRIME1;
+}
+
+static ma_uint64 tcb_hash_merge(ma_uint64 acc, ma_uint64 lane)
+{
+    acc ^= tcb_hash_round(0, lane);
+    return acc * HASH_PRIME1 + HASH_PRIME4;
+}
+
+/* XXH64, four lanes over 32 byte stripes, so PCM is hashed at memory speed. */
+void tcb_hash_init(tcb_hash *hash, ma_uint64 seed)
+{
+    memset(hash, 0, sizeof(*hash));
+    hash->seed = seed;
+    hash->lanes[0] = seed + HASH_PRIME1 + HASH_PRIME2;
+    hash->lanes[1] = seed + HASH_PRIME2;
+    hash->lanes[2] = seed;
+    hash->lanes[3] = seed - HASH_PRIME1;
+}
+
+void tcb_hash_update(tcb_hash *hash, const void *pData, size_t size)
+{
+    const ma_uint8 *p = (const ma_uint8 *)pData;
+    const ma_uint8 *end = p + size;
+    hash->totalLength += size;
+
+    if (hash->bufferSize + size < sizeof(hash->buffer))
+    {
+        memcpy(hash->buffer + hash->bufferSize, p, size);
+        hash->bufferSize += size;
+        return;
+    }
+
+    if (hash->bufferSize > 0)
+    {
+        size_t fill = sizeof(hash->buffer) - hash->bufferSize;
+        memcpy(hash->buffer + hash->bufferSize, p, fill);
+        for (int i = 0; i < 4; i++)
+        {
+            hash->lanes[i] = tcb_hash_round(hash->lanes[i], tcb_hash_read64(hash->buffer + i * 8));
+        }
+        p += fill;
+        hash->bufferSize = 0;
+    }
+
+    while (p + sizeof(hash->buffer) <= end)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            hash->lanes[i] = tcb_hash_round(hash->lanes[i], tcb_hash_read64(p + i * 8));
+        }
+        p += sizeof(hash->buffer);
+    }
+
+    hash->bufferSize = (size_t)(end - p);
+    memcpy(hash->buffer, p, hash->bufferSize);
+}
+
+ma_uint64 tcb_hash_final(const tcb_hash *hash)
+{
+    ma_uint64 h;
+    if (hash->totalLength >= sizeof(hash->buffer))
+    {
+        h = tcb_hash_rotl(hash->lanes[0], 1) + tcb_hash_rotl(hash->lanes[1], 7) + tcb_hash_rotl(hash->lanes[2], 12) + tcb_hash_rotl(hash->lanes[3], 18);
+        for (int i = 0; i < 4; i++)
+        {
+            h = tcb_hash_merge(h, hash->lanes[i]);
+        }
+    }
+    else
+    {
+        h = hash->seed + HASH_PRIME5;
+    }
+    h += hash->totalLength;
+
+    const ma_uint8 *p = hash->buffer;
+    const ma_uint8 *end = p + hash->bufferSize;
+    for (; p + 8 <= end; p += 8)
+    {
+        h ^= tcb_hash_round(0, tcb_hash_read64(p));
+        h = tcb_hash_rotl(h, 27) * HASH_PRIME1 + HASH_PRIME4;
+    }
+    if (p + 4 <= end)
+    {
+        ma_uint32 word;
+        memcpy(&word, p, sizeof(word));
+        h ^= (ma_uint64)word * HASH_PRIME1;
+        h = tcb_hash_rotl(h, 23) * HASH_PRIME2 + HASH_PRIME3;
+        p += 4;
+    }
+    for (; p < end; p++)
+    {
+        h ^= (ma_uint64)*p * HASH_PRIME5;
+        h = tcb_hash_rotl(h, 11) * HASH_PRIME1;
+    }
+
+    h ^= h >> 33;
+    h *= HASH_PRIME2;
+    h ^= h >> 29;
+    h *= HASH_PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+static void tcb_hash_string(tcb_hash *hash, const char *pString)
+{
+    /* The length goes first so NULL, "" and adjacent strings never hash alike. */
+    ma_uint64 length = pString != NULL ? strlen(pString) + 1 : 0;
+    tcb_hash_update(hash, &length, sizeof(length));
+    if (pString != NULL)
+    {
+        tcb_hash_update(hash, pString, length);
+    }
+}
+
+/*
+ * Everything besides the audio that changes what whisper returns: the
+ * model, identified by name, size and modification time so a replaced
+ * model invalidates its results, the chunking and VAD settings, and every
+ * decoding parameter. Thread counts and callbacks are left out.
+ */
+void tcb_cache_key_init(tcb_hash *hash, const struct whisper_full_params *params, const char *pKind)
+{
+    tcb_hash_init(hash, CACHE_VERSION);
+    tcb_hash_string(hash, pKind);
+
+    char modelPath[PATH_MAX];
+    snprintf(modelPath, sizeof(modelPath), "%s/%s/%s", getenv("HOME"), RECORD_FOLDER, MODEL_FILE);
+    struct stat st;
+    ma_int64 model[3] = {0, 0, 0};
+    if (stat(modelPath, &st) == 0)
+    {
+        model[0] = (ma_int64)st.st_size;
+        model[1] = (ma_int64)st.st_mtim.tv_sec;
+        model[2] = (ma_int64)st.st_mtim.tv_nsec;
+    }
+    tcb_hash_string(hash, MODEL_FILE);
+    tcb_hash_update(hash, model, sizeof(model));
+
+    const ma_int64 settings[] = {TARGET_SAMPLE_RATE, STREAM_WINDOW_MS, STREAM_SPLIT_SEARCH_MS, VAD_FRAME_MS, VAD_FLOOR_PERCENTILE, VAD_PAD_MS, VAD_MIN_SILENCE_MS,
+                                 (ma_int64)(VAD_MARGIN_DB * 1000), (ma_int64)(VAD_MIN_DB * 1000), WHISPER_BEAM_SIZE, REFINE_PAD_MS};
+    tcb_hash_update(hash, settings, sizeof(settings));
+
+    const ma_int64 decoding[] = {params->strategy, params->greedy.best_of, params->beam_search.beam_size, params->n_max_text_ctx, params->offset_ms, params->duration_ms,
+                                 params->translate, params->no_context, params->no_timestamps, params->single_segment, params->detect_language, params->suppress_blank};
+    const float thresholds[] = {params->beam_search.patience, params->temperature, params->temperature_inc, params->entropy_thold, params->logprob_thold, params->no_speech_thold,
+                                REFINE_LOGPROB_THRESHOLD, REFINE_ENTROPY_THRESHOLD};
+    tcb_hash_update(hash, decoding, sizeof(decoding));
+    tcb_hash_update(hash, thresholds, sizeof(thresholds));
+    tcb_hash_string(hash, params->language);
+    tcb_hash_string(hash, params->initial_prompt);
+}
+
+ma_uint64 tcb_cache_key(const struct whisper_full_params *params, const char *pKind, const ma_float *pFrames, ma_uint64 frameCount)
+{
+    tcb_hash hash;
+    tcb_cache_key_init(&hash, params, pKind);
+    tcb_hash_update(&hash, pFrames, frameCount * sizeof(ma_float));
+    return tcb_hash_final(&hash);
+}
+
+/* Keys the content hash of pFilePath by what stat says about it. 0 if it cannot be stat'ed. */
+ma_uint64 tcb_cache_alias_key(const struct whisper_full_params *params, const char *pFilePath)
+{
+    char path[PATH_MAX];
+    struct stat st;
+    if (realpath(pFilePath, path) == NULL || stat(path, &st) != 0)
+    {
+        return 0;
+    }
+
+    tcb_hash hash;
+    tcb_cache_key_init(&hash, params, "alias");
+    tcb_hash_string(&hash, path);
+    const ma_int64 file[] = {(ma_int64)st.st_size, (ma_int64)st.st_mtim.tv_sec, (ma_int64)st.st_mtim.tv_nsec, (ma_int64)st.st_ino};
+    tcb_hash_update(&hash, file, sizeof(file));
+    return tcb_hash_final(&hash);
+}
+
+/* Texts are kept NUL terminated. Segment texts are one line on disk, token texts are stored as hex. */
+static ma_result tcb_cache_entry_push_text(tcb_cache_entry *entry, const char *text, size_t length, bool singleLine, size_t *pOffset)
+{
+    if (entry->textLength + length + 1 > entry->textCapacity)
+    {
+        size_t capacity = ma_max(entry->textCapacity * 2, entry->textLength + length + 1024);
+        char *buffer = realloc(entry->text, capacity);
+        if (buffer == NULL)
+        {
+            return MA_OUT_OF_MEMORY;
+        }
+        entry->text = buffer;
+        entry->textCapacity = capacity;
+    }
+
+    *pOffset = entry->textLength;
+    for (size_t i = 0; i < length; i++)
+    {
+        entry->text[entry->textLength++] = singleLine && (text[i] == '\n' || text[i] == '\r') ? ' ' : text[i];
+    }
+    entry->text[entry->textLength++] = '\0';
+
+    return MA_SUCCESS;
+}
+
+ma_result tcb_cache_entry_append(tcb_cache_entry *entry, ma_int64 t0Ms, ma_int64 t1Ms, float logprob, float entropy, const char *text, size_t length)
+{
+    if (entry->segmentCount == entry->segmentCapacity)
+    {
+        size_t capacity = ma_max(entry->segmentCapacity * 2, 16);
+        tcb_cache_segment *segments = realloc(entry->segments, capacity * sizeof(tcb_cache_segment));
+        if (segments == NULL)
+        {
+            return MA_OUT_OF_MEMORY;
+        }
+        entry->segments = segments;
+        entry->segmentCapacity = capacity;
+    }
+
+    size_t textOffset;
+    if (tcb_cache_entry_push_text(entry, text, length, true, &textOffset) != MA_SUCCESS)
+    {
+        return MA_OUT_OF_MEMORY;
+    }
+
+    tcb_cache_segment *segment = &entry->segments[entry->segmentCount++];
+    segment->t0Ms = t0Ms;
+    segment->t1Ms = t1Ms;
+    segment->logprob = logprob;
+    segment->entropy = entropy;
+    segment->textOffset = textOffset;
+    segment->tokenOffset = entry->tokenCount;
+    segment->tokenCount = 0;
+
+    return MA_SUCCESS;
+}
+
+/* Adds a token to the last segment appended. */
+ma_result tcb_cache_entry_append_token(tcb_cache_entry *entry, ma_int32 id, float p, const char *text)
+{
+    if (entry->tokenCount == entry->tokenCapacity)
+    {
+        size_t capacity = ma_max(entry->tokenCapacity * 2, 64);
+        tcb_cache_token *tokens = realloc(entry->tokens, capacity * sizeof(tcb_cache_token));
+        if (tokens == NULL)
+        {
+            return MA_OUT_OF_MEMORY;
+        }
+        entry->tokens = tokens;
+        entry->tokenCapacity = capacity;
+    }
+
+    size_t textOffset;
+    if (entry->segmentCount == 0 || tcb_cache_entry_push_text(entry, text, strlen(text), false, &textOffset) != MA_SUCCESS)
+    {
+        return MA_OUT_OF_MEMORY;
+    }
+
+    tcb_cache_token *token = &entry->tokens[entry->tokenCount++];
+    token->id = id;
+    token->p = p;
+    token->textOffset = textOffset;
+    entry->segments[entry->segmentCount - 1].tokenCount++;
+
+    return MA_SUCCESS;
+}
+
+/* Appends segment i of pSource with new times, its tokens included. */
+ma_result tcb_cache_entry_copy(tcb_cache_entry *entry, const tcb_cache_entry *pSource, size_t segment, ma_int64 t0Ms, ma_int64 t1Ms)
+{
+    const tcb_cache_segment *source = &pSource->segments[segment];
+    const char *text = tcb_cache_entry_text(pSource, segment);
+    ma_result result = tcb_cache_entry_append(entry, t0Ms, t1Ms, source->logprob, source->entropy, text, strlen(text));
+    for (size_t i = 0; i < source->tokenCount && result == MA_SUCCESS; i++)
+    {
+        const tcb_cache_token *token = &pSource->tokens[source->tokenOffset + i];
+        result = tcb_cache_entry_append_token(entry, token->id, token->p, pSource->text + token->textOffset);
+    }
+
+    return result;
+}
+
+/*
+ * Gives segment i the text and tokens of every segment of pSource, merged.
+ * Like tcb_transcript_replace, the old ones stay unreferenced in the buffers.
+ */
+ma_result tcb_cache_entry_replace(tcb_cache_entry *entry, size_t segment, const tcb_cache_entry *pSource)
+{
+    if (segment >= entry->segmentCount || pSource->segmentCount == 0)
+    {
+        return MA_INVALID_ARGS;
+    }
+
+    /* The merged segment is built at the end, then moved over the old one. */
+    const size_t segmentCount = entry->segmentCount;
+    tcb_cache_segment original = entry->segments[segment];
+    float logprob = 0.0f;
+    float entropy = INFINITY;
+    size_t length = 0;
+    for (size_t i = 0; i < pSource->segmentCount; i++)
+    {
+        logprob += pSource->segments[i].logprob / pSource->segmentCount;
+        entropy = ma_min(entropy, pSource->segments[i].entropy);
+        length += strlen(tcb_cache_entry_text(pSource, i));
+    }
+
+    char *text = malloc(length + 1);
+    if (text == NULL)
+    {
+        return MA_OUT_OF_MEMORY;
+    }
+    text[0] = '\0';
+    for (size_t i = 0; i < pSource->segmentCount; i++)
+    {
+        strcat(text, tcb_cache_entry_text(pSource, i));
+    }
+
+    ma_result result = tcb_cache_entry_append(entry, original.t0Ms, original.t1Ms, logprob, entropy, text, length);
+    free(text);
+    for (size_t i = 0; i < pSource->segmentCount && result == MA_SUCCESS; i++)
+    {
+        const tcb_cache_segment *source = &pSource->segments[i];
+        for (size_t j = 0; j < source->tokenCount && result == MA_SUCCESS; j++)
+        {
+            const tcb_cache_token *token = &pSource->tokens[source->tokenOffset + j];
+            result = tcb_cache_entry_append_token(entry, token->id, token->p, pSource->text + token->textOffset);
+        }
+    }
+
+    if (result == MA_SUCCESS)
+    {
+        entry->segments[segment] = entry->segments[segmentCount];
+    }
+    entry->segmentCount = segmentCount;
+
+    return result;
+}
+
+const char *tcb_cache_entry_text(const tcb_cache_entry *entry, size_t segment)
+{
+    return entry->text + entry->segments[segment].textOffset;
+}
+
+const char *tcb_cache_entry_token_text(const tcb_cache_entry *entry, size_t token)
+{
+    return entry->text + entry->tokens[token].textOffset;
+}
+
+void tcb_cache_entry_reset(tcb_cache_entry *entry)
+{
+    entry->segmentCount = 0;
+    entry->tokenCount = 0;
+    entry->textLength = 0;
+}
+
+void tcb_cache_entry_uninit(tcb_cache_entry *entry)
+{
+    free(entry->segments);
+    free(entry->tokens);
+    free(entry->text);
+    memset(entry, 0, sizeof(*entry));
+}
+
+static void tcb_cache_file_path(ma_uint64 key, char *pPath, size_t pathSize)
+{
+    snprintf(pPath, pathSize, "%s/%s/%s/%016llx", getenv("HOME"), RECORD_FOLDER, CACHE_FOLDER, (unsigned long long)key);
+}
+
+static int tcb_cache_hex_digit(char c)
+{
+    return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+/* Reads "<id> <p> <hex text>" into pText, which has room for the whole line. */
+static ma_result tcb_cache_parse_token(const char *pLine, ma_int32 *pId, float *pP, char *pText)
+{
+    int id = 0;
+    int textStart = 0;
+    if (sscanf(pLine, "%d %f%n", &id, pP, &textStart) != 2 || pLine[textStart] != ' ')
+    {
+        return MA_INVALID_FILE;
+    }
+
+    const char *hex = pLine + textStart + 1;
+    size_t length = 0;
+    for (; hex[0] != '\n'; hex += 2)
+    {
+        int high = tcb_cache_hex_digit(hex[0]);
+        int low = high >= 0 ? tcb_cache_hex_digit(hex[1]) : -1;
+        if (low < 0)
+        {
+            return MA_INVALID_FILE;
+        }
+        pText[length++] = (char)(high * 16 + low);
+    }
+    pText[length] = '\0';
+    *pId = id;
+
+    return MA_SUCCESS;
+}
+
+ma_result tcb_cache_load(ma_uint64 key, tcb_cache_entry *entry)
+{
+    tcb_cache_entry_reset(entry);
+
+    char path[PATH_MAX];
+    tcb_cache_file_path(key, path, sizeof(path));
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return MA_DOES_NOT_EXIST;
+    }
+
+    unsigned int version = 0;
+    size_t count = 0;
+    ma_result result = fscanf(file, "tcb-cache %u %zu\n", &version, &count) == 2 && version == CACHE_VERSION ? MA_SUCCESS : MA_INVALID_FILE;
+
+    char *line = NULL;
+    size_t lineCapacity = 0;
+    char *tokenText = NULL;
+    size_t tokenTextCapacity = 0;
+    for (size_t i = 0; i < count && result == MA_SUCCESS; i++)
+    {
+        /* A torn or foreign file is a miss, the next store replaces it. */
+        ssize_t length = getline(&line, &lineCapacity, file);
+        long long t0 = 0, t1 = 0;
+        float logprob = 0.0f, entropy = 0.0f;
+        size_t tokenCount = 0;
+        int textStart = 0;
+        if (length <= 0 || line[length - 1] != '\n' ||
+            sscanf(line, "%lld %lld %f %f %zu%n", &t0, &t1, &logprob, &entropy, &tokenCount, &textStart) != 5 || line[textStart] != ' ')
+        {
+            result = MA_INVALID_FILE;
+            break;
+        }
+
+        /* Exactly one separator, whisper's texts usually start with a space of their own. */
+        textStart++;
+        result = tcb_cache_entry_append(entry, t0, t1, logprob, entropy, line + textStart, (size_t)length - 1 - (size_t)textStart);
+        for (size_t j = 0; j < tokenCount && result == MA_SUCCESS; j++)
+        {
+            length = getline(&line, &lineCapacity, file);
+            if (length <= 0 || line[length - 1] != '\n')
+            {
+                result = MA_INVALID_FILE;
+                break;
+            }
+
+            if ((size_t)length > tokenTextCapacity)
+            {
+                char *buffer = realloc(tokenText, (size_t)length);
+                if (buffer == NULL)
+                {
+                    result = MA_OUT_OF_MEMORY;
+                    break;
+                }
+                tokenText = buffer;
+                tokenTextCapacity = (size_t)length;
+            }
+
+            ma_int32 id;
+            float p;
+            result = tcb_cache_parse_token(line, &id, &p, tokenText);
+            if (result == MA_SUCCESS)
+            {
+                result = tcb_cache_entry_append_token(entry, id, p, tokenText);
+            }
+        }
+    }
+    free(line);
+    free(tokenText);
+    fclose(file);
+
+    if (result != MA_SUCCESS)
+    {
+        tcb_cache_entry_reset(entry);
+    }
+    return result;
+}
+
+/* Written to a temporary file and renamed, so a concurrent reader sees the old entry or the whole new one. */
+static FILE *tcb_cache_create(ma_uint64 key, char *pPath, size_t pathSize, char *pTempPath, size_t tempPathSize)
+{
+    snprintf(pPath, pathSize, "%s/%s/%s", getenv("HOME"), RECORD_FOLDER, CACHE_FOLDER);
+    mkdir(pPath, 0700);
+    tcb_cache_file_path(key, pPath, pathSize);
+    snprintf(pTempPath, tempPathSize, "%s.XXXXXX", pPath);
+
+    int fd = mkstemp(pTempPath);
+    FILE *file = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to write transcription cache: %s\n", pPath);
+        if (fd >= 0)
+        {
+            close(fd);
+            unlink(pTempPath);
+        }
+    }
+
+    return file;
+}
+
+static ma_result tcb_cache_commit(FILE *file, const char *pPath, const char *pTempPath)
+{
+    if (fclose(file) != 0 || rename(pTempPath, pPath) != 0)
+    {
+        fprintf(stderr, "Failed to write transcription cache: %s\n", pPath);
+        unlink(pTempPath);
+        return MA_ERROR;
+    }
+
+    return MA_SUCCESS;
+}
+
+ma_result tcb_cache_store(ma_uint64 key, const tcb_cache_entry *entry)
+{
+    char path[PATH_MAX];
+    char tempPath[PATH_MAX + 16];
+    FILE *file = tcb_cache_create(key, path, sizeof(path), tempPath, sizeof(tempPath));
+    if (file == NULL)
+    {
+        return MA_ERROR;
+    }
+
+    fprintf(file, "tcb-cache %u %zu\n", CACHE_VERSION, entry->segmentCount);
+    for (size_t i = 0; i < entry->segmentCount; i++)
+    {
+        const tcb_cache_segment *segment = &entry->segments[i];
+        fprintf(file, "%lld %lld %.9g %.9g %zu %s\n", (long long)segment->t0Ms, (long long)segment->t1Ms, segment->logprob, segment->entropy, segment->tokenCount, tcb_cache_entry_text(entry, i));
+        for (size_t j = segment->tokenOffset; j < segment->tokenOffset + segment->tokenCount; j++)
+        {
+            fprintf(file, "%d %.9g ", (int)entry->tokens[j].id, entry->tokens[j].p);
+            for (const unsigned char *c = (const unsigned char *)tcb_cache_entry_token_text(entry, j); *c != '\0'; c++)
+            {
+                fprintf(file, "%02x", *c);
+            }
+            fputc('\n', file);
+        }
+    }
+
+    return tcb_cache_commit(file, path, tempPath);
+}
+
+ma_result tcb_cache_alias_load(ma_uint64 alias, ma_uint64 *pKey)
+{
+    char path[PATH_MAX];
+    tcb_cache_file_path(alias, path, sizeof(path));
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return MA_DOES_NOT_EXIST;
+    }
+
+    unsigned int version = 0;
+    unsigned long long key = 0;
+    bool valid = fscanf(file, "tcb-alias %u %llx", &version, &key) == 2 && version == CACHE_VERSION;
+    fclose(file);
+    if (!valid)
+    {
+        return MA_INVALID_FILE;
+    }
+
+    *pKey = (ma_uint64)key;
+    return MA_SUCCESS;
+}
+
+ma_result tcb_cache_alias_store(ma_uint64 alias, ma_uint64 key)
+{
+    char path[PATH_MAX];
+    char tempPath[PATH_MAX + 16];
+    FILE *file = tcb_cache_create(alias, path, sizeof(path), tempPath, sizeof(tempPath));
+    if (file == NULL)
+    {
+        return MA_ERROR;
+    }
+
+    fprintf(file, "tcb-alias %u %016llx\n", CACHE_VERSION, (unsigned long long)key);
+    return tcb_cache_commit(file, path, tempPath);
+}
@@ -0,0 +1,656 @@
+#define _GNU_SOURCE
+#include "tcb.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+/*
+ * ~/.tcb/catalog is an append-only log, the last line about a file wins:
+ *   F <mtime ns> <size> <duration ms> <status> <language> <name>
+ *   D <name>                    the file is gone
+ *   S <folder mtime ns> <scan ns>  every file below was checked at scan ns
+ * Listing reads only this log while the folder mtime still matches the last
+ * S line. Otherwise the folder is scanned once, only new or changed files
+ * are opened for their duration, and the log gets what changed.
+ */
+typedef struct
+{
+    char *name;
+    size_t line;
+    ma_int64 mtimeNs;
+    ma_uint64 size;
+    ma_uint64 durationMs;
+    tcb_record_status status;
+    char language[16];
+    bool removed;
+    bool seen;
+} tcb_catalog_entry;
+
+typedef struct
+{
+    tcb_catalog_entry *entries;
+    size_t count;
+    size_t capacity;
+    size_t lineCount;
+    ma_int64 folderMtimeNs;
+    ma_int64 scanNs;
+} tcb_catalog;
+
+static const char *tcb_catalog_status_names[] = {"recorded", "transcribed", "failed"};
+
+static void tcb_catalog_folder_path(char *pPath, size_t pathSize)
+{
+    snprintf(pPath, pathSize, "%s/%s", getenv("HOME"), RECORD_FOLDER);
+}
+
+static ma_int64 tcb_catalog_mtime_ns(const struct stat *st)
+{
+    return (ma_int64)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+}
+
+static int tcb_catalog_parse_status(const char *pName)
+{
+    for (int i = 0; i < (int)(sizeof(tcb_catalog_status_names) / sizeof(tcb_catalog_status_names[0])); i++)
+    {
+        if (strcmp(pName, tcb_catalog_status_names[i]) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* Compaction replaces the file, so a lock taken on the old one is retried on the new one. */
+static int tcb_catalog_open(void)
+{
+    char path[PATH_MAX];
+    char folderPath[512];
+    tcb_catalog_folder_path(folderPath, sizeof(folderPath));
+    snprintf(path, sizeof(path), "%s/%s", folderPath, CATALOG_FILE);
+
+    while (1)
+    {
+        int fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+        if (fd < 0 || flock(fd, LOCK_EX) != 0)
+        {
+            fprintf(stderr, "Failed to open record catalog: %s\n", path);
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            return -1;
+        }
+
+        struct stat opened, current;
+        if (fstat(fd, &opened) == 0 && stat(path, &current) == 0 && opened.st_ino == current.st_ino)
+        {
+            return fd;
+        }
+        close(fd);
+    }
+}
+
+static void tcb_catalog_close(int fd)
+{
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+/* A line torn by a crash is terminated first so the new one is not glued to it. */
+static ma_result tcb_catalog_append(int fd, const char *pLine)
+{
+    struct stat st;
+    char last = '\n';
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && pread(fd, &last, 1, st.st_size - 1) == 1 && last != '\n')
+    {
+        if (write(fd, "\n", 1) != 1)
+        {
+            return MA_ERROR;
+        }
+    }
+
+    size_t length = strlen(pLine);
+    return write(fd, pLine, length) == (ssize_t)length ? MA_SUCCESS : MA_ERROR;
+}
+
+static void tcb_catalog_format_entry(const tcb_catalog_entry *entry, char *pLine, size_t lineSize)
+{
+    snprintf(pLine, lineSize, "F %lld %llu %llu %s %s %s\n",
+             (long long)entry->mtimeNs,
+             (unsigned long long)entry->size,
+             (unsigned long long)entry->durationMs,
+             tcb_catalog_status_names[entry->status],
+             entry->language,
+             entry->name);
+}
+
+static void tcb_catalog_set_language(tcb_catalog_entry *entry, const char *language)
+{
+    snprintf(entry->language, sizeof(entry->language), "%s", language != NULL && language[0] != '\0' ? language : "-");
+    for (char *c = entry->language; *c != '\0'; c++)
+    {
+        if (*c == ' ' || *c == '\t' || *c == '\n')
+        {
+            *c = '_';
+        }
+    }
+}
+
+/* Reads the length from the header, every format tcb writes is one libsndfile opens. */
+ma_uint64 tcb_catalog_probe_duration(const char *pFilePath)
+{
+    SF_INFO info;
+    memset(&info, 0, sizeof(info));
+    SNDFILE *file = sf_open(pFilePath, SFM_READ, &info);
+    if (file == NULL)
+    {
+        return 0;
+    }
+    sf_close(file);
+
+    return info.samplerate > 0 ? (ma_uint64)info.frames * 1000 / (ma_uint64)info.samplerate : 0;
+}
+
+static void tcb_catalog_free(tcb_catalog *catalog)
+{
+    for (size_t i = 0; i < catalog->count; i++)
+    {
+        free(catalog->entries[i].name);
+    }
+    free(catalog->entries);
+    memset(catalog, 0, sizeof(*catalog));
+}
+
+static tcb_catalog_entry *tcb_catalog_push(tcb_catalog *catalog, const char *pName)
+{
+    if (catalog->count == catalog->capacity)
+    {
+        size_t capacity = ma_max(catalog->capacity * 2, 256);
+        tcb_catalog_entry *grown = realloc(catalog->entries, capacity * sizeof(tcb_catalog_entry));
+        if (grown == NULL)
+        {
+            return NULL;
+        }
+        catalog->entries = grown;
+        catalog->capacity = capacity;
+    }
+
+    tcb_catalog_entry *entry = &catalog->entries[catalog->count];
+    memset(entry, 0, sizeof(*entry));
+    entry->name = strdup(pName);
+    if (entry->name == NULL)
+    {
+        return NULL;
+    }
+    entry->line = catalog->lineCount;
+    catalog->count++;
+    return entry;
+}
+
+static int tcb_catalog_entry_compare(const void *a, const void *b)
+{
+    const tcb_catalog_entry *x = (const tcb_catalog_entry *)a;
+    const tcb_catalog_entry *y = (const tcb_catalog_entry *)b;
+    int order = strcmp(x->name, y->name);
+    return order != 0 ? order : (x->line > y->line) - (x->line < y->line);
+}
+
+/* Leaves one entry per file, sorted by name, the latest line about each. */
+static ma_result tcb_catalog_load(int fd, tcb_catalog *catalog)
+{
+    memset(catalog, 0, sizeof(*catalog));
+
+    int readFd = dup(fd);
+    FILE *file = readFd >= 0 ? fdopen(readFd, "r") : NULL;
+    if (file == NULL)
+    {
+        if (readFd >= 0)
+        {
+            close(readFd);
+        }
+        return MA_ERROR;
+    }
+    rewind(file);
+
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        size_t length = strcspn(line, "\n");
+        if (line[length] != '\n')
+        {
+            continue;
+        }
+        line[length] = '\0';
+        catalog->lineCount++;
+
+        long long mtimeNs, scanNs;
+        unsigned long long size, durationMs;
+        char status[16], language[16];
+        int nameStart = 0;
+        tcb_catalog_entry *entry = NULL;
+        if (sscanf(line, "S %lld %lld", &mtimeNs, &scanNs) == 2)
+        {
+            catalog->folderMtimeNs = mtimeNs;
+            catalog->scanNs = scanNs;
+        }
+        else if (sscanf(line, "F %lld %llu %llu %15s %15s %n", &mtimeNs, &size, &durationMs, status, language, &nameStart) == 5 &&
+                 nameStart > 0 && tcb_catalog_parse_status(status) >= 0)
+        {
+            entry = tcb_catalog_push(catalog, line + nameStart);
+            if (entry != NULL)
+            {
+                entry->mtimeNs = mtimeNs;
+                entry->size = size;
+                entry->durationMs = durationMs;
+                entry->status = (tcb_record_status)tcb_catalog_parse_status(status);
+                tcb_catalog_set_language(entry, language);
+            }
+        }
+        else if (line[0] == 'D' && line[1] == ' ' && line[2] != '\0')
+        {
+            entry = tcb_catalog_push(catalog, line + 2);
+            if (entry != NULL)
+            {
+                entry->removed = true;
+            }
+        }
+        else
+        {
+            continue;
+        }
+
+        if ((line[0] == 'F' || line[0] == 'D') && entry == NULL)
+        {
+            fclose(file);
+            tcb_catalog_free(catalog);
+            return MA_OUT_OF_MEMORY;
+        }
+    }
+    fclose(file);
+
+    if (catalog->count == 0)
+    {
+        return MA_SUCCESS;
+    }
+
+    qsort(catalog->entries, catalog->count, sizeof(tcb_catalog_entry), tcb_catalog_entry_compare);
+    size_t kept = 0;
+    for (size_t i = 0; i < catalog->count; i++)
+    {
+        tcb_catalog_entry *entry = &catalog->entries[i];
+        bool latest = i + 1 == catalog->count || strcmp(entry->name, catalog->entries[i + 1].name) != 0;
+        if (!latest || entry->removed)
+        {
+            free(entry->name);
+            continue;
+        }
+        catalog->entries[kept++] = *entry;
+    }
+    catalog->count = kept;
+
+    return MA_SUCCESS;
+}
+
+static tcb_catalog_entry *tcb_catalog_find(tcb_catalog *catalog, size_t sortedCount, const char *pName)
+{
+    tcb_catalog_entry key;
+    key.name = (char *)pName;
+    key.line = 0;
+
+    size_t lo = 0;
+    size_t hi = sortedCount;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        int order = strcmp(catalog->entries[mid].name, key.name);
+        if (order == 0)
+        {
+            return &catalog->entries[mid];
+        }
+        if (order < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return NULL;
+}
+
+/* Rewrites the log with one line per file once superseded lines outnumber the live ones. */
+static void tcb_catalog_compact(const tcb_catalog *catalog, const char *pFolderPath)
+{
+    char path[PATH_MAX];
+    char tempPath[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", pFolderPath, CATALOG_FILE);
+    snprintf(tempPath, sizeof(tempPath), "%s/%s.tmp", pFolderPath, CATALOG_FILE);
+
+    FILE *file = fopen(tempPath, "w");
+    if (file == NULL)
+    {
+        return;
+    }
+
+    bool failed = false;
+    char line[1024];
+    for (size_t i = 0; i < catalog->count && !failed; i++)
+    {
+        if (catalog->entries[i].removed)
+        {
+            continue;
+        }
+        tcb_catalog_format_entry(&catalog->entries[i], line, sizeof(line));
+        failed = fputs(line, file) == EOF;
+    }
+    failed = fprintf(file, "S %lld %lld\n", (long long)catalog->folderMtimeNs, (long long)catalog->scanNs) < 0 || failed;
+    failed = fflush(file) != 0 || fsync(fileno(file)) != 0 || failed;
+    failed = fclose(file) != 0 || failed;
+
+    if (failed || rename(tempPath, path) != 0)
+    {
+        unlink(tempPath);
+    }
+}
+
+/*
+ * Brings the catalog in line with the folder. A folder mtime equal to the
+ * one of the last scan means no file was added or removed since, provided
+ * that mtime was already settled when the scan ran: timestamps are coarse,
+ * and a file created in the same tick right after a scan would not move it.
+ */
+static ma_result tcb_catalog_refresh(int fd, tcb_catalog *catalog)
+{
+    char folderPath[512];
+    tcb_catalog_folder_path(folderPath, sizeof(folderPath));
+
+    struct stat folderStat;
+    if (stat(folderPath, &folderStat) != 0)
+    {
+        perror("Failed to open record folder");
+        fprintf(stderr, "Folder path: %s\n", folderPath);
+        return MA_ERROR;
+    }
+
+    ma_int64 folderMtimeNs = tcb_catalog_mtime_ns(&folderStat);
+    ma_int64 settleNs = (ma_int64)CATALOG_SETTLE_MS * 1000000;
+    if (folderMtimeNs == catalog->folderMtimeNs && catalog->scanNs - folderMtimeNs > settleNs)
+    {
+        return MA_SUCCESS;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    ma_int64 scanNs = (ma_int64)now.tv_sec * 1000000000 + now.tv_nsec;
+
+    DIR *dir = opendir(folderPath);
+    if (dir == NULL)
+    {
+        perror("Failed to open record folder");
+        fprintf(stderr, "Folder path: %s\n", folderPath);
+        return MA_ERROR;
+    }
+
+    size_t sortedCount = catalog->count;
+    size_t appended = 0;
+    char line[1024];
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (!tcb_is_record_file(entry->d_name))
+        {
+            continue;
+        }
+
+        char path[PATH_MAX];
+        char transcriptPath[PATH_MAX];
+        struct stat st, transcriptStat;
+        snprintf(path, sizeof(path), "%s/%s", folderPath, entry->d_name);
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+        {
+            continue;
+        }
+        bool transcribed = tcb_transcript_path(path, transcriptPath, sizeof(transcriptPath)) == MA_SUCCESS && stat(transcriptPath, &transcriptStat) == 0;
+
+        tcb_catalog_entry *known = tcb_catalog_find(catalog, sortedCount, entry->d_name);
+        if (known != NULL)
+        {
+            known->seen = true;
+            bool unchanged = known->mtimeNs == tcb_catalog_mtime_ns(&st) && known->size == (ma_uint64)st.st_size;
+            /* A failed transcription may have left part of a transcript behind, it stays failed. */
+            bool statusKnown = transcribed ? known->status != TCB_RECORD_RECORDED : known->status != TCB_RECORD_TRANSCRIBED;
+            if (unchanged && statusKnown)
+            {
+                continue;
+            }
+
+            if (!unchanged)
+            {
+                known->mtimeNs = tcb_catalog_mtime_ns(&st);
+                known->size = (ma_uint64)st.st_size;
+                known->durationMs = tcb_catalog_probe_duration(path);
+            }
+            if (!statusKnown)
+            {
+                known->status = transcribed ? TCB_RECORD_TRANSCRIBED : TCB_RECORD_RECORDED;
+            }
+        }
+        else
+        {
+            known = tcb_catalog_push(catalog, entry->d_name);
+            if (known == NULL)
+            {
+                closedir(dir);
+                return MA_OUT_OF_MEMORY;
+            }
+            known->seen = true;
+            known->mtimeNs = tcb_catalog_mtime_ns(&st);
+            known->size = (ma_uint64)st.st_size;
+            known->durationMs = tcb_catalog_probe_duration(path);
+            known->status = transcribed ? TCB_RECORD_TRANSCRIBED : TCB_RECORD_RECORDED;
+            tcb_catalog_set_language(known, NULL);
+        }
+
+        tcb_catalog_format_entry(known, line, sizeof(line));
+        tcb_catalog_append(fd, line);
+        appended++;
+    }
+    closedir(dir);
+
+    for (size_t i = 0; i < sortedCount; i++)
+    {
+        if (!catalog->entries[i].seen)
+        {
+            catalog->entries[i].removed = true;
+            snprintf(line, sizeof(line), "D %s\n", catalog->entries[i].name);
+            tcb_catalog_append(fd, line);
+            appended++;
+        }
+    }
+
+    catalog->folderMtimeNs = folderMtimeNs;
+    catalog->scanNs = scanNs;
+    snprintf(line, sizeof(line), "S %lld %lld\n", (long long)folderMtimeNs, (long long)scanNs);
+    tcb_catalog_append(fd, line);
+    catalog->lineCount += appended + 1;
+
+    if (catalog->lineCount > 2 * catalog->count + 64)
+    {
+        tcb_catalog_compact(catalog, folderPath);
+    }
+
+    return MA_SUCCESS;
+}
+
+void tcb_catalog_add(const char *pFilePath, tcb_record_status status, const char *language)
+{
+    /* Entries are keyed by name, so only files the scan would list belong here. */
+    char filePath[PATH_MAX];
+    char folderPath[512];
+    char folderRealPath[PATH_MAX];
+    tcb_catalog_folder_path(folderPath, sizeof(folderPath));
+    if (realpath(pFilePath, filePath) == NULL || realpath(folderPath, folderRealPath) == NULL)
+    {
+        return;
+    }
+
+    const char *slash = strrchr(filePath, '/');
+    size_t folderLength = strlen(folderRealPath);
+    if (slash == NULL || (size_t)(slash - filePath) != folderLength || strncmp(filePath, folderRealPath, folderLength) != 0 || !tcb_is_record_file(slash + 1))
+    {
+        return;
+    }
+
+    struct stat st;
+    if (stat(filePath, &st) != 0)
+    {
+        return;
+    }
+
+    tcb_catalog_entry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.name = (char *)(slash + 1);
+    entry.mtimeNs = tcb_catalog_mtime_ns(&st);
+    entry.size = (ma_uint64)st.st_size;
+    entry.durationMs = tcb_catalog_probe_duration(pFilePath);
+    entry.status = status;
+    tcb_catalog_set_language(&entry, language);
+
+    /* A recording is listed again on the next scan, the catalog only saves reopening it. */
+    int fd = tcb_catalog_open();
+    if (fd < 0)
+    {
+        return;
+    }
+
+    char line[1024];
+    tcb_catalog_format_entry(&entry, line, sizeof(line));
+    if (tcb_catalog_append(fd, line) != MA_SUCCESS)
+    {
+        fprintf(stderr, "Failed to update record catalog for: %s\n", pFilePath);
+    }
+    tcb_catalog_close(fd);
+}
+
+tcb_catalog_filter tcb_catalog_filter_init(void)
+{
+    tcb_catalog_filter filter;
+    filter.sort = TCB_CATALOG_SORT_DATE;
+    filter.reverse = false;
+    filter.since = 0;
+    filter.until = 0;
+    filter.minDurationMs = 0;
+    filter.maxDurationMs = 0;
+    filter.status = -1;
+    return filter;
+}
+
+static int tcb_catalog_list_compare(const void *a, const void *b, void *arg)
+{
+    const tcb_catalog_entry *x = *(const tcb_catalog_entry *const *)a;
+    const tcb_catalog_entry *y = *(const tcb_catalog_entry *const *)b;
+    int order = 0;
+    switch (*(const tcb_catalog_sort *)arg)
+    {
+    case TCB_CATALOG_SORT_DURATION:
+        order = (x->durationMs > y->durationMs) - (x->durationMs < y->durationMs);
+        break;
+    case TCB_CATALOG_SORT_SIZE:
+        order = (x->size > y->size) - (x->size < y->size);
+        break;
+    case TCB_CATALOG_SORT_DATE:
+        order = (x->mtimeNs > y->mtimeNs) - (x->mtimeNs < y->mtimeNs);
+        break;
+    case TCB_CATALOG_SORT_NAME:
+        break;
+    }
+
+    return order != 0 ? order : strcmp(x->name, y->name);
+}
+
+int tcb_catalog_list(const tcb_catalog_filter *filter)
+{
+    int fd = tcb_catalog_open();
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    tcb_catalog catalog;
+    if (tcb_catalog_load(fd, &catalog) != MA_SUCCESS)
+    {
+        fprintf(stderr, "Failed to read record catalog.\n");
+        tcb_catalog_close(fd);
+        return -1;
+    }
+
+    ma_result result = tcb_catalog_refresh(fd, &catalog);
+    tcb_catalog_close(fd);
+    if (result != MA_SUCCESS)
+    {
+        tcb_catalog_free(&catalog);
+        return -1;
+    }
+
+    tcb_catalog_entry **shown = malloc(ma_max(catalog.count, 1) * sizeof(tcb_catalog_entry *));
+    if (shown == NULL)
+    {
+        tcb_catalog_free(&catalog);
+        return -1;
+    }
+
+    size_t shownCount = 0;
+    for (size_t i = 0; i < catalog.count; i++)
+    {
+        tcb_catalog_entry *entry = &catalog.entries[i];
+        time_t mtime = (time_t)(entry->mtimeNs / 1000000000);
+        if (entry->removed ||
+            (filter->since != 0 && mtime < filter->since) ||
+            (filter->until != 0 && mtime >= filter->until) ||
+            entry->durationMs < filter->minDurationMs ||
+            (filter->maxDurationMs != 0 && entry->durationMs > filter->maxDurationMs) ||
+            (filter->status >= 0 && (int)entry->status != filter->status))
+        {
+            continue;
+        }
+        shown[shownCount++] = entry;
+    }
+
+    tcb_catalog_sort sort = filter->sort;
+    qsort_r(shown, shownCount, sizeof(tcb_catalog_entry *), tcb_catalog_list_compare, &sort);
+
+    printf("Available Records:\n");
+    for (size_t i = 0; i < shownCount; i++)
+    {
+        const tcb_catalog_entry *entry = shown[filter->reverse ? shownCount - 1 - i : i];
+        time_t mtime = (time_t)(entry->mtimeNs / 1000000000);
+        char date[32];
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M", localtime(&mtime));
+
+        ma_uint64 seconds = entry->durationMs / 1000;
+        printf("    %zu: %s  %s  %02llu:%02llu:%02llu  %7.1f MB  %-11s  %s\n",
+               i,
+               entry->name,
+               date,
+               (unsigned long long)(seconds / 3600),
+               (unsigned long long)(seconds / 60 % 60),
+               (unsigned long long)(seconds % 60),
+               (double)entry->size / (1024.0 * 1024.0),
+               tcb_catalog_status_names[entry->status],
+               entry->language);
+    }
+
+    free(shown);
+    tcb_catalog_free(&catalog);
+    return 0;
+}
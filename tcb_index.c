@@ -0,0 +1,891 @@
+#define _GNU_SOURCE
+#include "tcb.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#define INDEX_TOKEN_MAX 64
+
+typedef struct
+{
+    ma_uint64 hash;
+    ma_uint32 segment;
+    ma_uint32 reserved;
+} tcb_index_posting;
+
+typedef struct
+{
+    ma_uint32 firstSegment;
+    ma_uint32 segmentCount;
+    bool latest;
+    char *path;
+} tcb_index_doc;
+
+typedef struct
+{
+    tcb_index_doc *docs;
+    size_t count;
+} tcb_index_docs;
+
+static ma_result tcb_transcript_reserve_text(tcb_transcript *transcript, size_t length)
+{
+    if (transcript->textLength + length > transcript->textCapacity)
+    {
+        size_t capacity = ma_max(transcript->textCapacity * 2, transcript->textLength + length + 4096);
+        char *buffer = realloc(transcript->text, capacity);
+        if (buffer == NULL)
+        {
+            return MA_OUT_OF_MEMORY;
+        }
+        transcript->text = buffer;
+        transcript->textCapacity = capacity;
+    }
+
+    return MA_SUCCESS;
+}
+
+ma_result tcb_transcript_append(tcb_transcript *transcript, ma_int64 t0Ms, ma_int64 t1Ms, const char *text)
+{
+    size_t length = strlen(text);
+    if (transcript->segmentCount == transcript->segmentCapacity)
+    {
+        size_t capacity = ma_max(transcript->segmentCapacity * 2, 64);
+        tcb_index_segment *segments = realloc(transcript->segments, capacity * sizeof(tcb_index_segment));
+        if (segments == NULL)
+        {
+            return MA_OUT_OF_MEMORY;
+        }
+        transcript->segments = segments;
+        transcript->segmentCapacity = capacity;
+    }
+
+    if (tcb_transcript_reserve_text(transcript, length) != MA_SUCCESS)
+    {
+        return MA_OUT_OF_MEMORY;
+    }
+
+    tcb_index_segment *segment = &transcript->segments[transcript->segmentCount++];
+    segment->doc = 0;
+    segment->textLength = (ma_uint32)length;
+    segment->t0Ms = t0Ms;
+    segment->t1Ms = t1Ms;
+    segment->textOffset = transcript->textLength;
+    if (length > 0)
+    {
+        memcpy(transcript->text + transcript->textLength, text, length);
+        transcript->textLength += length;
+    }
+
+    return MA_SUCCESS;
+}
+
+/* The new text goes to the end, the old one is left unreferenced in the buffer. */
+ma_result tcb_transcript_replace(tcb_transcript *transcript, size_t segment, const char *text)
+{
+    size_t length = strlen(text);
+    if (segment >= transcript->segmentCount || tcb_transcript_reserve_text(transcript, length) != MA_SUCCESS)
+    {
+        return MA_INVALID_ARGS;
+    }
+
+    memcpy(transcript->text + transcript->textLength, text, length);
+    transcript->segments[segment].textOffset = transcript->textLength;
+    transcript->segments[segment].textLength = (ma_uint32)length;
+    transcript->textLength += length;
+
+    return MA_SUCCESS;
+}
+
+void tcb_transcript_uninit(tcb_transcript *transcript)
+{
+    free(transcript->segments);
+    free(transcript->text);
+    memset(transcript, 0, sizeof(*transcript));
+}
+
+static void tcb_index_file_path(const char *pName, char *pPath, size_t pathSize)
+{
+    snprintf(pPath, pathSize, "%s/%s/%s/%s", getenv("HOME"), RECORD_FOLDER, INDEX_FOLDER, pName);
+}
+
+/* Words are lowercased ASCII, any byte above 0x7F is kept so UTF-8 words stay whole. */
+static size_t tcb_index_next_token(const char **pText, const char *pEnd, char *pToken)
+{
+    const unsigned char *p = (const unsigned char *)*pText;
+    const unsigned char *end = (const unsigned char *)pEnd;
+    while (p < end && !(isalnum(*p) || *p >= 0x80))
+    {
+        p++;
+    }
+
+    size_t length = 0;
+    while (p < end && (isalnum(*p) || *p >= 0x80))
+    {
+        if (length + 1 < INDEX_TOKEN_MAX)
+        {
+            pToken[length++] = (char)(*p < 0x80 ? tolower(*p) : *p);
+        }
+        p++;
+    }
+    pToken[length] = '\0';
+
+    *pText = (const char *)p;
+    return length;
+}
+
+static ma_uint64 tcb_index_hash(const char *pToken)
+{
+    /* FNV-1a. */
+    ma_uint64 hash = 0xcbf29ce484222325ull;
+    for (const unsigned char *p = (const unsigned char *)pToken; *p != '\0'; p++)
+    {
+        hash = (hash ^ *p) * 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static bool tcb_index_text_has_token(const char *pText, size_t length, const char *pToken)
+{
+    char token[INDEX_TOKEN_MAX];
+    const char *end = pText + length;
+    while (tcb_index_next_token(&pText, end, token) > 0)
+    {
+        if (strcmp(token, pToken) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int tcb_index_lock(int operation)
+{
+    char path[512];
+    tcb_index_file_path("", path, sizeof(path));
+    mkdir(path, 0700);
+    tcb_index_file_path("postings", path, sizeof(path));
+    mkdir(path, 0700);
+
+    tcb_index_file_path("lock", path, sizeof(path));
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0 || flock(fd, operation) != 0)
+    {
+        fprintf(stderr, "Failed to lock search index: %s\n", path);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+
+    return fd;
+}
+
+static void tcb_index_unlock(int fd)
+{
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+static void tcb_index_docs_free(tcb_index_docs *docs)
+{
+    for (size_t i = 0; i < docs->count; i++)
+    {
+        free(docs->docs[i].path);
+    }
+    free(docs->docs);
+    docs->docs = NULL;
+    docs->count = 0;
+}
+
+static int tcb_index_doc_compare(const void *a, const void *b)
+{
+    const tcb_index_doc *x = *(const tcb_index_doc *const *)a;
+    const tcb_index_doc *y = *(const tcb_index_doc *const *)b;
+    int order = strcmp(x->path, y->path);
+    return order != 0 ? order : (x->firstSegment > y->firstSegment) - (x->firstSegment < y->firstSegment);
+}
+
+/*
+ * Reads the docs file, one "<first segment> <segment count> <path>" line per
+ * indexed recording. A recording indexed again supersedes its older lines,
+ * only the last one is marked latest.
+ */
+static ma_result tcb_index_docs_load(tcb_index_docs *docs)
+{
+    memset(docs, 0, sizeof(*docs));
+
+    char path[512];
+    tcb_index_file_path("docs", path, sizeof(path));
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return MA_SUCCESS;
+    }
+
+    size_t capacity = 0;
+    char line[PATH_MAX + 64];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        unsigned int firstSegment, segmentCount;
+        int pathStart = 0;
+        size_t length = strcspn(line, "\n");
+        if (line[length] != '\n' || sscanf(line, "%u %u %n", &firstSegment, &segmentCount, &pathStart) != 2 || pathStart == 0)
+        {
+            continue;
+        }
+        line[length] = '\0';
+
+        if (docs->count == capacity)
+        {
+            capacity = ma_max(capacity * 2, 256);
+            tcb_index_doc *grown = realloc(docs->docs, capacity * sizeof(tcb_index_doc));
+            if (grown == NULL)
+            {
+                fclose(file);
+                tcb_index_docs_free(docs);
+                return MA_OUT_OF_MEMORY;
+            }
+            docs->docs = grown;
+        }
+
+        tcb_index_doc *doc = &docs->docs[docs->count];
+        doc->firstSegment = firstSegment;
+        doc->segmentCount = segmentCount;
+        doc->latest = false;
+        doc->path = strdup(line + pathStart);
+        if (doc->path == NULL)
+        {
+            fclose(file);
+            tcb_index_docs_free(docs);
+            return MA_OUT_OF_MEMORY;
+        }
+        docs->count++;
+    }
+    fclose(file);
+
+    tcb_index_doc **sorted = malloc(ma_max(docs->count, 1) * sizeof(tcb_index_doc *));
+    if (sorted == NULL)
+    {
+        tcb_index_docs_free(docs);
+        return MA_OUT_OF_MEMORY;
+    }
+
+    for (size_t i = 0; i < docs->count; i++)
+    {
+        sorted[i] = &docs->docs[i];
+    }
+    qsort(sorted, docs->count, sizeof(tcb_index_doc *), tcb_index_doc_compare);
+    for (size_t i = 0; i < docs->count; i++)
+    {
+        sorted[i]->latest = i + 1 == docs->count || strcmp(sorted[i]->path, sorted[i + 1]->path) != 0;
+    }
+    free(sorted);
+
+    return MA_SUCCESS;
+}
+
+/* Docs are appended in segment order, so the owner of a segment is found by bisection. */
+static const tcb_index_doc *tcb_index_docs_find(const tcb_index_docs *docs, ma_uint32 segment)
+{
+    size_t lo = 0;
+    size_t hi = docs->count;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (docs->docs[mid].firstSegment <= segment)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    if (lo == 0)
+    {
+        return NULL;
+    }
+
+    const tcb_index_doc *doc = &docs->docs[lo - 1];
+    return segment - doc->firstSegment < doc->segmentCount ? doc : NULL;
+}
+
+static int tcb_index_posting_compare(const void *a, const void *b)
+{
+    const tcb_index_posting *x = (const tcb_index_posting *)a;
+    const tcb_index_posting *y = (const tcb_index_posting *)b;
+    ma_uint32 bucketX = (ma_uint32)(x->hash % INDEX_BUCKETS);
+    ma_uint32 bucketY = (ma_uint32)(y->hash % INDEX_BUCKETS);
+    if (bucketX != bucketY)
+    {
+        return (bucketX > bucketY) - (bucketX < bucketY);
+    }
+
+    return (x->segment > y->segment) - (x->segment < y->segment);
+}
+
+static ma_result tcb_index_write_postings(const tcb_index_posting *postings, size_t count)
+{
+    size_t start = 0;
+    while (start < count)
+    {
+        ma_uint32 bucket = (ma_uint32)(postings[start].hash % INDEX_BUCKETS);
+        size_t end = start;
+        while (end < count && postings[end].hash % INDEX_BUCKETS == bucket)
+        {
+            end++;
+        }
+
+        char name[32];
+        char path[512];
+        snprintf(name, sizeof(name), "postings/%03x", bucket);
+        tcb_index_file_path(name, path, sizeof(path));
+        FILE *file = fopen(path, "ab");
+        if (file == NULL || fwrite(postings + start, sizeof(tcb_index_posting), end - start, file) != end - start)
+        {
+            fprintf(stderr, "Failed to write search index: %s\n", path);
+            if (file != NULL)
+            {
+                fclose(file);
+            }
+            return MA_ERROR;
+        }
+        fclose(file);
+        start = end;
+    }
+
+    return MA_SUCCESS;
+}
+
+/*
+ * Appends one transcript. The text, the segment records and the postings
+ * go first and the docs line last, so a crash part way leaves segments no
+ * doc claims and search never shows them.
+ */
+static ma_result tcb_index_add_locked(const char *pRecordingPath, const tcb_transcript *transcript, ma_uint32 docCount)
+{
+    char segmentsPath[512];
+    char textPath[512];
+    char docsPath[512];
+    tcb_index_file_path("segments", segmentsPath, sizeof(segmentsPath));
+    tcb_index_file_path("text", textPath, sizeof(textPath));
+    tcb_index_file_path("docs", docsPath, sizeof(docsPath));
+
+    FILE *segmentsFile = fopen(segmentsPath, "ab");
+    FILE *textFile = fopen(textPath, "ab");
+    if (segmentsFile == NULL || textFile == NULL)
+    {
+        fprintf(stderr, "Failed to open search index.\n");
+        if (segmentsFile != NULL)
+        {
+            fclose(segmentsFile);
+        }
+        if (textFile != NULL)
+        {
+            fclose(textFile);
+        }
+        return MA_ERROR;
+    }
+
+    /* A torn record from an interrupted add is cut off so ids stay aligned. */
+    fseek(segmentsFile, 0, SEEK_END);
+    long segmentsSize = ftell(segmentsFile);
+    ma_uint32 firstSegment = (ma_uint32)(segmentsSize / (long)sizeof(tcb_index_segment));
+    if (segmentsSize % (long)sizeof(tcb_index_segment) != 0 && ftruncate(fileno(segmentsFile), (off_t)firstSegment * sizeof(tcb_index_segment)) != 0)
+    {
+        fprintf(stderr, "Failed to repair search index.\n");
+    }
+    fseek(textFile, 0, SEEK_END);
+    ma_uint64 textBase = (ma_uint64)ftell(textFile);
+
+    size_t postingCount = 0;
+    size_t postingCapacity = 0;
+    tcb_index_posting *postings = NULL;
+    ma_result result = fwrite(transcript->text, 1, transcript->textLength, textFile) == transcript->textLength ? MA_SUCCESS : MA_ERROR;
+    for (size_t i = 0; i < transcript->segmentCount && result == MA_SUCCESS; i++)
+    {
+        tcb_index_segment segment = transcript->segments[i];
+        segment.doc = docCount;
+        segment.textOffset += textBase;
+        if (fwrite(&segment, sizeof(segment), 1, segmentsFile) != 1)
+        {
+            result = MA_ERROR;
+            break;
+        }
+
+        size_t segmentPostings = postingCount;
+        const char *text = transcript->text + transcript->segments[i].textOffset;
+        const char *end = text + transcript->segments[i].textLength;
+        char token[INDEX_TOKEN_MAX];
+        while (tcb_index_next_token(&text, end, token) > 0)
+        {
+            ma_uint64 hash = tcb_index_hash(token);
+            bool seen = false;
+            for (size_t p = segmentPostings; p < postingCount && !seen; p++)
+            {
+                seen = postings[p].hash == hash;
+            }
+            if (seen)
+            {
+                continue;
+            }
+
+            if (postingCount == postingCapacity)
+            {
+                postingCapacity = ma_max(postingCapacity * 2, 1024);
+                tcb_index_posting *grown = realloc(postings, postingCapacity * sizeof(tcb_index_posting));
+                if (grown == NULL)
+                {
+                    result = MA_OUT_OF_MEMORY;
+                    break;
+                }
+                postings = grown;
+            }
+
+            postings[postingCount].hash = hash;
+            postings[postingCount].segment = firstSegment + (ma_uint32)i;
+            postings[postingCount].reserved = 0;
+            postingCount++;
+        }
+    }
+    fclose(textFile);
+    fclose(segmentsFile);
+
+    if (result == MA_SUCCESS)
+    {
+        qsort(postings, postingCount, sizeof(tcb_index_posting), tcb_index_posting_compare);
+        result = tcb_index_write_postings(postings, postingCount);
+    }
+    free(postings);
+
+    if (result == MA_SUCCESS)
+    {
+        FILE *docsFile = fopen(docsPath, "a");
+        if (docsFile == NULL || fprintf(docsFile, "%u %u %s\n", firstSegment, (ma_uint32)transcript->segmentCount, pRecordingPath) < 0)
+        {
+            result = MA_ERROR;
+        }
+        if (docsFile != NULL && fclose(docsFile) != 0)
+        {
+            result = MA_ERROR;
+        }
+    }
+
+    return result;
+}
+
+static ma_uint32 tcb_index_count_docs(void)
+{
+    char path[512];
+    tcb_index_file_path("docs", path, sizeof(path));
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return 0;
+    }
+
+    ma_uint32 count = 0;
+    int c;
+    int last = '\n';
+    while ((c = fgetc(file)) != EOF)
+    {
+        count += c == '\n' ? 1 : 0;
+        last = c;
+    }
+    fclose(file);
+
+    /* A line torn by a crash is terminated so the next one is not glued to it. */
+    if (last != '\n')
+    {
+        file = fopen(path, "a");
+        if (file != NULL)
+        {
+            fputc('\n', file);
+            fclose(file);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+ma_result tcb_index_add(const char *pRecordingPath, const tcb_transcript *transcript)
+{
+    char recordingPath[PATH_MAX];
+    if (realpath(pRecordingPath, recordingPath) == NULL)
+    {
+        snprintf(recordingPath, sizeof(recordingPath), "%s", pRecordingPath);
+    }
+
+    int lock = tcb_index_lock(LOCK_EX);
+    if (lock < 0)
+    {
+        return MA_ERROR;
+    }
+
+    ma_result result = tcb_index_add_locked(recordingPath, transcript, tcb_index_count_docs());
+    tcb_index_unlock(lock);
+    if (result != MA_SUCCESS)
+    {
+        fprintf(stderr, "Failed to update search index for: %s\n", recordingPath);
+    }
+
+    return result;
+}
+
+/*
+ * Reads a transcript written before the index existed. Lines written with
+ * timestamps keep them, plain lines are indexed at offset 0.
+ */
+static ma_result tcb_index_read_transcript(const char *pTranscriptPath, tcb_transcript *transcript)
+{
+    FILE *file = fopen(pTranscriptPath, "r");
+    if (file == NULL)
+    {
+        return MA_INVALID_FILE;
+    }
+
+    ma_result result = MA_SUCCESS;
+    char line[4096];
+    while (result == MA_SUCCESS && fgets(line, sizeof(line), file) != NULL)
+    {
+        line[strcspn(line, "\n")] = '\0';
+
+        unsigned int h0, m0, s0, ms0, h1, m1, s1, ms1;
+        int textStart = 0;
+        ma_int64 t0 = 0;
+        ma_int64 t1 = 0;
+        const char *text = line;
+        if (sscanf(line, "[%u:%u:%u.%u --> %u:%u:%u.%u] %n", &h0, &m0, &s0, &ms0, &h1, &m1, &s1, &ms1, &textStart) == 8 && textStart > 0)
+        {
+            t0 = (((ma_int64)h0 * 60 + m0) * 60 + s0) * 1000 + ms0;
+            t1 = (((ma_int64)h1 * 60 + m1) * 60 + s1) * 1000 + ms1;
+            text = line + textStart;
+        }
+
+        if (*text != '\0')
+        {
+            result = tcb_transcript_append(transcript, t0, t1, text);
+        }
+    }
+    fclose(file);
+
+    return result;
+}
+
+int tcb_index_missing(void)
+{
+    char folderPath[512];
+    snprintf(folderPath, sizeof(folderPath), "%s/%s", getenv("HOME"), RECORD_FOLDER);
+    DIR *dir = opendir(folderPath);
+    if (dir == NULL)
+    {
+        perror("Failed to open record folder");
+        return -1;
+    }
+
+    int lock = tcb_index_lock(LOCK_EX);
+    if (lock < 0)
+    {
+        closedir(dir);
+        return -1;
+    }
+
+    ma_uint32 docCount = tcb_index_count_docs();
+    tcb_index_docs docs;
+    if (tcb_index_docs_load(&docs) != MA_SUCCESS)
+    {
+        fprintf(stderr, "Failed to read search index.\n");
+        tcb_index_unlock(lock);
+        closedir(dir);
+        return -1;
+    }
+
+    int indexed = 0;
+    int failed = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (!tcb_is_record_file(entry->d_name))
+        {
+            continue;
+        }
+
+        char path[PATH_MAX];
+        char transcriptPath[PATH_MAX];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", folderPath, entry->d_name);
+        if (tcb_transcript_path(path, transcriptPath, sizeof(transcriptPath)) != MA_SUCCESS || stat(transcriptPath, &st) != 0)
+        {
+            continue;
+        }
+
+        char recordingPath[PATH_MAX];
+        if (realpath(path, recordingPath) == NULL)
+        {
+            continue;
+        }
+
+        bool known = false;
+        for (size_t i = 0; i < docs.count && !known; i++)
+        {
+            known = strcmp(docs.docs[i].path, recordingPath) == 0;
+        }
+        if (known)
+        {
+            continue;
+        }
+
+        tcb_transcript transcript;
+        memset(&transcript, 0, sizeof(transcript));
+        if (tcb_index_read_transcript(transcriptPath, &transcript) == MA_SUCCESS &&
+            tcb_index_add_locked(recordingPath, &transcript, docCount) == MA_SUCCESS)
+        {
+            docCount++;
+            indexed++;
+        }
+        else
+        {
+            fprintf(stderr, "Failed to index: %s\n", transcriptPath);
+            failed++;
+        }
+        tcb_transcript_uninit(&transcript);
+    }
+    closedir(dir);
+    tcb_index_docs_free(&docs);
+    tcb_index_unlock(lock);
+
+    printf("Indexed %d transcripts\n", indexed);
+    return failed;
+}
+
+static int tcb_index_segment_compare(const void *a, const void *b)
+{
+    ma_uint32 x = *(const ma_uint32 *)a;
+    ma_uint32 y = *(const ma_uint32 *)b;
+    return (x > y) - (x < y);
+}
+
+/* Segment ids whose postings carry this token's hash, sorted and unique. */
+static ma_uint32 *tcb_index_lookup(const char *pToken, size_t *pCount)
+{
+    *pCount = 0;
+    ma_uint64 hash = tcb_index_hash(pToken);
+
+    char name[32];
+    char path[512];
+    snprintf(name, sizeof(name), "postings/%03x", (ma_uint32)(hash % INDEX_BUCKETS));
+    tcb_index_file_path(name, path, sizeof(path));
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    size_t postingCount = (size_t)ftell(file) / sizeof(tcb_index_posting);
+    fseek(file, 0, SEEK_SET);
+
+    tcb_index_posting *postings = malloc(ma_max(postingCount, 1) * sizeof(tcb_index_posting));
+    ma_uint32 *segments = malloc(ma_max(postingCount, 1) * sizeof(ma_uint32));
+    if (postings == NULL || segments == NULL)
+    {
+        free(postings);
+        free(segments);
+        fclose(file);
+        return NULL;
+    }
+
+    postingCount = fread(postings, sizeof(tcb_index_posting), postingCount, file);
+    fclose(file);
+
+    size_t count = 0;
+    for (size_t i = 0; i < postingCount; i++)
+    {
+        if (postings[i].hash == hash)
+        {
+            segments[count++] = postings[i].segment;
+        }
+    }
+    free(postings);
+
+    qsort(segments, count, sizeof(ma_uint32), tcb_index_segment_compare);
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (unique == 0 || segments[unique - 1] != segments[i])
+        {
+            segments[unique++] = segments[i];
+        }
+    }
+
+    *pCount = unique;
+    return segments;
+}
+
+int tcb_index_search(const char *pQuery, ma_uint32 limit)
+{
+    char tokens[16][INDEX_TOKEN_MAX];
+    size_t tokenCount = 0;
+    const char *query = pQuery;
+    const char *queryEnd = pQuery + strlen(pQuery);
+    char token[INDEX_TOKEN_MAX];
+    while (tcb_index_next_token(&query, queryEnd, token) > 0 && tokenCount < 16)
+    {
+        bool seen = false;
+        for (size_t i = 0; i < tokenCount && !seen; i++)
+        {
+            seen = strcmp(tokens[i], token) == 0;
+        }
+        if (!seen)
+        {
+            strcpy(tokens[tokenCount++], token);
+        }
+    }
+
+    if (tokenCount == 0)
+    {
+        fprintf(stderr, "Specify at least one word to search for.\n");
+        return -1;
+    }
+
+    int lock = tcb_index_lock(LOCK_SH);
+    if (lock < 0)
+    {
+        return -1;
+    }
+
+    tcb_index_docs docs;
+    if (tcb_index_docs_load(&docs) != MA_SUCCESS)
+    {
+        fprintf(stderr, "Failed to read search index.\n");
+        tcb_index_unlock(lock);
+        return -1;
+    }
+
+    /* Every word must match, so the candidates are the intersection of all posting lists. */
+    size_t candidateCount = 0;
+    ma_uint32 *candidates = tcb_index_lookup(tokens[0], &candidateCount);
+    for (size_t t = 1; t < tokenCount && candidateCount > 0; t++)
+    {
+        size_t count = 0;
+        ma_uint32 *segments = tcb_index_lookup(tokens[t], &count);
+        size_t kept = 0;
+        for (size_t i = 0, j = 0; i < candidateCount && j < count;)
+        {
+            if (candidates[i] < segments[j])
+            {
+                i++;
+            }
+            else if (candidates[i] > segments[j])
+            {
+                j++;
+            }
+            else
+            {
+                candidates[kept++] = candidates[i];
+                i++;
+                j++;
+            }
+        }
+        candidateCount = kept;
+        free(segments);
+    }
+
+    char segmentsPath[512];
+    char textPath[512];
+    tcb_index_file_path("segments", segmentsPath, sizeof(segmentsPath));
+    tcb_index_file_path("text", textPath, sizeof(textPath));
+    int segmentsFd = open(segmentsPath, O_RDONLY | O_CLOEXEC);
+    int textFd = open(textPath, O_RDONLY | O_CLOEXEC);
+
+    /* Newest recordings first, each one's matches in order. Hash collisions and superseded transcripts are dropped here. */
+    ma_uint32 matches = 0;
+    char text[4096];
+    size_t end = candidateCount;
+    while (end > 0 && segmentsFd >= 0 && textFd >= 0 && matches < limit)
+    {
+        const tcb_index_doc *doc = tcb_index_docs_find(&docs, candidates[end - 1]);
+        if (doc == NULL)
+        {
+            end--;
+            continue;
+        }
+
+        size_t begin = end - 1;
+        while (begin > 0 && candidates[begin - 1] >= doc->firstSegment)
+        {
+            begin--;
+        }
+
+        bool printedPath = false;
+        for (size_t c = begin; c < end && doc->latest && matches < limit; c++)
+        {
+            tcb_index_segment segment;
+            if (pread(segmentsFd, &segment, sizeof(segment), (off_t)candidates[c] * sizeof(segment)) != sizeof(segment))
+            {
+                continue;
+            }
+
+            size_t length = ma_min(segment.textLength, sizeof(text) - 1);
+            if (pread(textFd, text, length, (off_t)segment.textOffset) != (ssize_t)length)
+            {
+                continue;
+            }
+            text[length] = '\0';
+
+            bool match = true;
+            for (size_t t = 0; t < tokenCount && match; t++)
+            {
+                match = tcb_index_text_has_token(text, length, tokens[t]);
+            }
+            if (!match)
+            {
+                continue;
+            }
+
+            if (!printedPath)
+            {
+                printf("%s\n", doc->path);
+                printedPath = true;
+            }
+
+            char start[32];
+            tcb_format_timestamp(start, sizeof(start), segment.t0Ms);
+            printf("    %10lld ms  [%s] %s\n", (long long)segment.t0Ms, start, text);
+            matches++;
+        }
+        end = begin;
+    }
+
+    if (segmentsFd >= 0)
+    {
+        close(segmentsFd);
+    }
+    if (textFd >= 0)
+    {
+        close(textFd);
+    }
+    free(candidates);
+    tcb_index_docs_free(&docs);
+    tcb_index_unlock(lock);
+
+    if (matches == 0)
+    {
+        printf("No matches.\n");
+    }
+
+    return 0;
+}
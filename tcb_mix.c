@@ -0,0 +1,217 @@
+#define _GNU_SOURCE
+#include "tcb.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TCB_MIX_X86
+#endif
+
+/*
+ * Every variant computes, per frame, ((src0 * g0) + src1 * g1) + ... in
+ * source order with separate multiply and add roundings, then clamps with
+ * max-then-min semantics. That keeps all of them bit-identical to the
+ * scalar kernel, including for NaN and signed zero. This file is built
+ * with -ffp-contract=off so the compiler cannot fuse the scalar path.
+ */
+static inline ma_float tcb_mix_frame(const ma_float *const *ppSources, const ma_float *pGains, ma_uint32 sourceCount, ma_uint64 i)
+{
+    ma_float sum = ppSources[0][i] * pGains[0];
+    for (ma_uint32 s = 1; s < sourceCount; s++)
+    {
+        sum = sum + ppSources[s][i] * pGains[s];
+    }
+
+    sum = sum > -1.0f ? sum : -1.0f;
+    sum = sum < 1.0f ? sum : 1.0f;
+    return sum;
+}
+
+void tcb_mix_scalar(ma_float *pOut, const ma_float *const *ppSources, const ma_float *pGains, ma_uint32 sourceCount, ma_uint64 frameCount)
+{
+    for (ma_uint64 i = 0; i < frameCount; i++)
+    {
+        pOut[i] = tcb_mix_frame(ppSources, pGains, sourceCount, i);
+    }
+}
+
+#ifdef TCB_MIX_X86
+__attribute__((target("sse2"))) void tcb_mix_sse2(ma_float *pOut, const ma_float *const *ppSources, const ma_float *pGains, ma_uint32 sourceCount, ma_uint64 frameCount)
+{
+    const __m128 lo = _mm_set1_ps(-1.0f);
+    const __m128 hi = _mm_set1_ps(1.0f);
+    ma_uint64 i = 0;
+    for (; i + 4 <= frameCount; i += 4)
+    {
+        __m128 sum = _mm_mul_ps(_mm_loadu_ps(ppSources[0] + i), _mm_set1_ps(pGains[0]));
+        for (ma_uint32 s = 1; s < sourceCount; s++)
+        {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(ppSources[s] + i), _mm_set1_ps(pGains[s])));
+        }
+        _mm_storeu_ps(pOut + i, _mm_min_ps(_mm_max_ps(sum, lo), hi));
+    }
+
+    for (; i < frameCount; i++)
+    {
+        pOut[i] = tcb_mix_frame(ppSources, pGains, sourceCount, i);
+    }
+}
+
+__attribute__((target("avx2"))) void tcb_mix_avx2(ma_float *pOut, const ma_float *const *ppSources, const ma_float *pGains, ma_uint32 sourceCount, ma_uint64 frameCount)
+{
+    const __m256 lo = _mm256_set1_ps(-1.0f);
+    const __m256 hi = _mm256_set1_ps(1.0f);
+    ma_uint64 i = 0;
+    for (; i + 8 <= frameCount; i += 8)
+    {
+        __m256 sum = _mm256_mul_ps(_mm256_loadu_ps(ppSources[0] + i), _mm256_set1_ps(pGains[0]));
+        for (ma_uint32 s = 1; s < sourceCount; s++)
+        {
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(ppSources[s] + i), _mm256_set1_ps(pGains[s])));
+        }
+        _mm256_storeu_ps(pOut + i, _mm256_min_ps(_mm256_max_ps(sum, lo), hi));
+    }
+
+    for (; i < frameCount; i++)
+    {
+        pOut[i] = tcb_mix_frame(ppSources, pGains, sourceCount, i);
+    }
+}
+
+__attribute__((target("avx512f"))) void tcb_mix_avx512(ma_float *pOut, const ma_float *const *ppSources, const ma_float *pGains, ma_uint32 sourceCount, ma_uint64 frameCount)
+{
+    const __m512 lo = _mm512_set1_ps(-1.0f);
+    const __m512 hi = _mm512_set1_ps(1.0f);
+    ma_uint64 i = 0;
+    for (; i + 16 <= frameCount; i += 16)
+    {
+        __m512 sum = _mm512_mul_ps(_mm512_loadu_ps(ppSources[0] + i), _mm512_set1_ps(pGains[0]));
+        for (ma_uint32 s = 1; s < sourceCount; s++)
+        {
+            sum = _mm512_add_ps(sum, _mm512_mul_ps(_mm512_loadu_ps(ppSources[s] + i), _mm512_set1_ps(pGains[s])));
+        }
+        _mm512_storeu_ps(pOut + i, _mm512_min_ps(_mm512_max_ps(sum, lo), hi));
+    }
+
+    for (; i < frameCount; i++)
+    {
+        pOut[i] = tcb_mix_frame(ppSources, pGains, sourceCount, i);
+    }
+}
+
+static bool tcb_mix_has_sse2(void) { return __builtin_cpu_supports("sse2"); }
+static bool tcb_mix_has_avx2(void) { return __builtin_cpu_supports("avx2"); }
+static bool tcb_mix_has_avx512(void) { return __builtin_cpu_supports("avx512f"); }
+#endif
+
+static bool tcb_mix_has_scalar(void) { return true; }
+
+/* Ordered from slowest to fastest; the last supported entry wins. */
+static const tcb_mix_kernel g_mixKernels[] = {
+    {"scalar", tcb_mix_scalar, tcb_mix_has_scalar},
+#ifdef TCB_MIX_X86
+    {"sse2", tcb_mix_sse2, tcb_mix_has_sse2},
+    {"avx2", tcb_mix_avx2, tcb_mix_has_avx2},
+    {"avx512", tcb_mix_avx512, tcb_mix_has_avx512},
+#endif
+};
+
+const tcb_mix_kernel *tcb_mix_kernels(size_t *pCount)
+{
+    *pCount = sizeof(g_mixKernels) / sizeof(g_mixKernels[0]);
+    return g_mixKernels;
+}
+
+const tcb_mix_kernel *tcb_mix_kernel_select(void)
+{
+#ifdef TCB_MIX_X86
+    __builtin_cpu_init();
+#endif
+
+    const tcb_mix_kernel *kernel = &g_mixKernels[0];
+    size_t kernelCount;
+    const tcb_mix_kernel *kernels = tcb_mix_kernels(&kernelCount);
+    for (size_t k = 0; k < kernelCount; k++)
+    {
+        if (kernels[k].supported())
+        {
+            kernel = &kernels[k];
+        }
+    }
+
+    return kernel;
+}
+
+int tcb_mix_bench(ma_uint32 sourceCount, ma_uint64 frameCount, ma_uint32 iterations)
+{
+    size_t sourceBytes = (frameCount * sizeof(ma_float) + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+    ma_float *data = aligned_alloc(ARENA_ALIGNMENT, sourceBytes * (sourceCount + 2));
+    const ma_float **sources = malloc(sourceCount * sizeof(ma_float *));
+    ma_float *gains = malloc(sourceCount * sizeof(ma_float));
+    if (!data || !sources || !gains)
+    {
+        fprintf(stderr, "Failed to allocate benchmark buffers.\n");
+        free(data);
+        free(sources);
+        free(gains);
+        return -1;
+    }
+
+    /* Loud enough that a good share of frames hit the clamp. */
+    srand(1);
+    for (ma_uint32 s = 0; s < sourceCount; s++)
+    {
+        ma_float *source = (ma_float *)((ma_uint8 *)data + s * sourceBytes);
+        for (ma_uint64 i = 0; i < frameCount; i++)
+        {
+            source[i] = (ma_float)rand() / RAND_MAX * 1.6f - 0.8f;
+        }
+        sources[s] = source;
+        gains[s] = 1.0f / (1.0f + 0.25f * s);
+    }
+
+    ma_float *reference = (ma_float *)((ma_uint8 *)data + sourceCount * sourceBytes);
+    ma_float *output = (ma_float *)((ma_uint8 *)data + (sourceCount + 1) * sourceBytes);
+    tcb_mix_scalar(reference, sources, gains, sourceCount, frameCount);
+
+    printf("Mixing %u sources x %llu frames, %u iterations (selected: %s)\n",
+           sourceCount, (unsigned long long)frameCount, iterations, tcb_mix_kernel_select()->name);
+
+    int failures = 0;
+    size_t kernelCount;
+    const tcb_mix_kernel *kernels = tcb_mix_kernels(&kernelCount);
+    for (size_t k = 0; k < kernelCount; k++)
+    {
+        if (!kernels[k].supported())
+        {
+            printf("    %-8s unsupported\n", kernels[k].name);
+            continue;
+        }
+
+        kernels[k].proc(output, sources, gains, sourceCount, frameCount);
+        bool exact = memcmp(output, reference, frameCount * sizeof(ma_float)) == 0;
+        failures += exact ? 0 : 1;
+
+        ma_uint64 start = tcb_time_ns();
+        for (ma_uint32 it = 0; it < iterations; it++)
+        {
+            kernels[k].proc(output, sources, gains, sourceCount, frameCount);
+        }
+        double seconds = (double)(tcb_time_ns() - start) / 1e9;
+        double frames = (double)frameCount * iterations;
+
+        printf("    %-8s %10.1f Mframes/s %8.2f GB/s  %s\n",
+               kernels[k].name,
+               frames / seconds / 1e6,
+               frames * (sourceCount + 1) * sizeof(ma_float) / seconds / 1e9,
+               exact ? "bit-exact" : "MISMATCH");
+    }
+
+    free(data);
+    free(sources);
+    free(gains);
+    return failures;
+}
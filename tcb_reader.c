@@ -0,0 +1,243 @@
+#define _GNU_SOURCE
+#include "tcb.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+static ma_uint32 tcb_read_le16(const ma_uint8 *p)
+{
+    return (ma_uint32)p[0] | ((ma_uint32)p[1] << 8);
+}
+
+static ma_uint32 tcb_read_le32(const ma_uint8 *p)
+{
+    return (ma_uint32)p[0] | ((ma_uint32)p[1] << 8) | ((ma_uint32)p[2] << 16) | ((ma_uint32)p[3] << 24);
+}
+
+/* Finds the sample data of a float mono WAV at TARGET_SAMPLE_RATE, anything else is left to the decoder. */
+static ma_result tcb_mapped_wav_parse(tcb_mapped_wav *map)
+{
+    const ma_uint8 *data = (const ma_uint8 *)map->base;
+    if (map->size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0)
+    {
+        return MA_INVALID_FILE;
+    }
+
+    bool nativeFormat = false;
+    size_t offset = 12;
+    while (offset + 8 <= map->size)
+    {
+        const ma_uint8 *chunk = data + offset;
+        size_t chunkSize = tcb_read_le32(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16 && offset + 8 + chunkSize <= map->size)
+        {
+            ma_uint32 formatTag = tcb_read_le16(chunk + 8);
+            if (formatTag == WAVE_FORMAT_EXTENSIBLE && chunkSize >= 40)
+            {
+                formatTag = tcb_read_le16(chunk + 8 + 24);
+            }
+
+            nativeFormat = formatTag == WAVE_FORMAT_IEEE_FLOAT &&
+                           tcb_read_le16(chunk + 8 + 2) == TARGET_CHANNELS &&
+                           tcb_read_le32(chunk + 8 + 4) == TARGET_SAMPLE_RATE &&
+                           tcb_read_le16(chunk + 8 + 14) == 32;
+        }
+        else if (memcmp(chunk, "data", 4) == 0)
+        {
+            if (!nativeFormat || (offset + 8) % sizeof(ma_float) != 0)
+            {
+                return MA_INVALID_FILE;
+            }
+
+            /* A recording that never got its final header still has every checkpointed frame. */
+            size_t available = map->size - offset - 8;
+            if (chunkSize == 0 || chunkSize > available)
+            {
+                chunkSize = available;
+            }
+
+            map->pFrames = (const ma_float *)(chunk + 8);
+            map->frameCount = chunkSize / sizeof(ma_float);
+            return MA_SUCCESS;
+        }
+
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    return MA_INVALID_FILE;
+}
+
+ma_result tcb_mapped_wav_open(tcb_mapped_wav *map, const char *pFilePath)
+{
+    memset(map, 0, sizeof(*map));
+
+    int fd = open(pFilePath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return MA_INVALID_FILE;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return MA_INVALID_FILE;
+    }
+
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        return MA_INVALID_FILE;
+    }
+
+    map->base = base;
+    map->size = (size_t)st.st_size;
+    if (tcb_mapped_wav_parse(map) != MA_SUCCESS)
+    {
+        tcb_mapped_wav_close(map);
+        return MA_INVALID_FILE;
+    }
+
+    /* Chunks are read front to back, let the kernel read ahead. */
+    madvise(map->base, map->size, MADV_SEQUENTIAL);
+    return MA_SUCCESS;
+}
+
+void tcb_mapped_wav_close(tcb_mapped_wav *map)
+{
+    if (map->base != NULL)
+    {
+        munmap(map->base, map->size);
+    }
+    map->base = NULL;
+    map->pFrames = NULL;
+    map->frameCount = 0;
+}
+
+/*
+ * miniaudio decodes WAV, FLAC and MP3 on its own. Anything else, Opus
+ * recordings in particular, is read through libsndfile and converted with
+ * the same data converter the capture path uses.
+ */
+static ma_result tcb_reader_init_sndfile(tcb_reader *reader, const char *pFilePath)
+{
+    memset(&reader->info, 0, sizeof(reader->info));
+    reader->file = sf_open(pFilePath, SFM_READ, &reader->info);
+    if (reader->file == NULL)
+    {
+        return MA_INVALID_FILE;
+    }
+
+    ma_data_converter_config converterConfig = ma_data_converter_config_init(
+        ma_format_f32,
+        TARGET_FORMAT,
+        (ma_uint32)reader->info.channels,
+        TARGET_CHANNELS,
+        (ma_uint32)reader->info.samplerate,
+        TARGET_SAMPLE_RATE);
+
+    reader->block = malloc((size_t)DECODE_BLOCK_FRAMES * reader->info.channels * sizeof(float));
+    if (reader->block == NULL || ma_data_converter_init(&converterConfig, NULL, &reader->converter) != MA_SUCCESS)
+    {
+        free(reader->block);
+        sf_close(reader->file);
+        reader->block = NULL;
+        reader->file = NULL;
+        return MA_ERROR;
+    }
+
+    return MA_SUCCESS;
+}
+
+ma_result tcb_reader_init(tcb_reader *reader, const char *pFilePath)
+{
+    memset(reader, 0, sizeof(*reader));
+
+    ma_decoder_config decoderConfig = ma_decoder_config_init(TARGET_FORMAT, TARGET_CHANNELS, TARGET_SAMPLE_RATE);
+    if (ma_decoder_init_file(pFilePath, &decoderConfig, &reader->decoder) == MA_SUCCESS)
+    {
+        reader->useDecoder = true;
+        return MA_SUCCESS;
+    }
+
+    ma_result result = tcb_reader_init_sndfile(reader, pFilePath);
+    if (result != MA_SUCCESS)
+    {
+        fprintf(stderr, "Failed to initialize decoder for file: %s\n", pFilePath);
+    }
+
+    return result;
+}
+
+ma_result tcb_reader_read(tcb_reader *reader, ma_float *pFramesOut, ma_uint64 frameCount, ma_uint64 *pFramesRead)
+{
+    if (reader->useDecoder)
+    {
+        return ma_decoder_read_pcm_frames(&reader->decoder, pFramesOut, frameCount, pFramesRead);
+    }
+
+    ma_uint64 framesRead = 0;
+    while (framesRead < frameCount)
+    {
+        if (reader->blockOffset == reader->blockFrames)
+        {
+            reader->blockFrames = reader->atEnd ? 0 : (ma_uint64)ma_max(sf_readf_float(reader->file, reader->block, DECODE_BLOCK_FRAMES), 0);
+            reader->blockOffset = 0;
+            reader->atEnd = reader->blockFrames < DECODE_BLOCK_FRAMES;
+
+            /* A short read is only the end of the file if libsndfile says nothing went wrong. */
+            if (reader->atEnd && sf_error(reader->file) != SF_ERR_NO_ERROR)
+            {
+                fprintf(stderr, "Failed to decode file: %s\n", sf_strerror(reader->file));
+                *pFramesRead = framesRead;
+                return MA_ERROR;
+            }
+        }
+
+        ma_uint64 frameCountIn = reader->blockFrames - reader->blockOffset;
+        ma_uint64 frameCountOut = frameCount - framesRead;
+        const float *pFramesIn = reader->block + reader->blockOffset * reader->info.channels;
+        if (ma_data_converter_process_pcm_frames(&reader->converter, pFramesIn, &frameCountIn, pFramesOut + framesRead, &frameCountOut) != MA_SUCCESS)
+        {
+            *pFramesRead = framesRead;
+            return MA_ERROR;
+        }
+
+        reader->blockOffset += frameCountIn;
+        framesRead += frameCountOut;
+        if (frameCountIn == 0 && frameCountOut == 0)
+        {
+            break;
+        }
+    }
+
+    *pFramesRead = framesRead;
+    return framesRead < frameCount ? MA_AT_END : MA_SUCCESS;
+}
+
+void tcb_reader_uninit(tcb_reader *reader)
+{
+    if (reader->useDecoder)
+    {
+        ma_decoder_uninit(&reader->decoder);
+        return;
+    }
+
+    if (reader->file != NULL)
+    {
+        ma_data_converter_uninit(&reader->converter, NULL);
+        sf_close(reader->file);
+        free(reader->block);
+        reader->file = NULL;
+        reader->block = NULL;
+    }
+}
@@ -0,0 +1,251 @@
+#define _GNU_SOURCE
+#include "tcb.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/*
+ * Line protocol over a Unix socket, one job per connection:
+ *   client: TRANSCRIBE <language> <formats> <beam> <cache> <threads> <absolute path>
+ *   server: SEGMENT <text>     (zero or more)
+ *           OK <transcript path> | ERROR <message>
+ */
+
+static volatile sig_atomic_t g_serveStop = 0;
+
+static void tcb_serve_on_signal(int signal)
+{
+    g_serveStop = 1;
+    (void)signal;
+}
+
+static void tcb_serve_send_segment(void *pUserData, ma_int64 t0Ms, ma_int64 t1Ms, const char *text)
+{
+    int client = *(int *)pUserData;
+    dprintf(client, "SEGMENT %s\n", text);
+    (void)t0Ms;
+    (void)t1Ms;
+}
+
+void tcb_socket_path(char *pSocketPath, size_t socketPathSize)
+{
+    char *home = getenv("HOME");
+    snprintf(pSocketPath, socketPathSize, "%s/%s/%s", home, RECORD_FOLDER, SERVE_SOCKET_FILE);
+}
+
+static int tcb_socket_address(const char *pSocketPath, struct sockaddr_un *address)
+{
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(pSocketPath) >= sizeof(address->sun_path))
+    {
+        fprintf(stderr, "Socket path is too long: %s\n", pSocketPath);
+        return -1;
+    }
+    strcpy(address->sun_path, pSocketPath);
+
+    return 0;
+}
+
+static ssize_t tcb_read_line(int fd, char *buffer, size_t bufferSize)
+{
+    size_t length = 0;
+    while (length + 1 < bufferSize)
+    {
+        char c;
+        ssize_t n = read(fd, &c, 1);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        if (c == '\n')
+        {
+            buffer[length] = '\0';
+            return (ssize_t)length;
+        }
+        buffer[length++] = c;
+    }
+
+    buffer[length] = '\0';
+    return -1;
+}
+
+static void tcb_serve_job(struct whisper_context *ctx, int client)
+{
+    char request[PATH_MAX + 128];
+    if (tcb_read_line(client, request, sizeof(request)) < 0)
+    {
+        dprintf(client, "ERROR malformed request\n");
+        return;
+    }
+
+    char language[64];
+    unsigned int formats;
+    int beam;
+    int cache;
+    int threads;
+    int pathOffset = 0;
+    if (sscanf(request, "TRANSCRIBE %63s %u %d %d %d %n", language, &formats, &beam, &cache, &threads, &pathOffset) != 5 || pathOffset == 0 || request[pathOffset] == '\0')
+    {
+        dprintf(client, "ERROR unknown request\n");
+        return;
+    }
+    char *filePath = request + pathOffset;
+    formats = (formats & ((1u << TCB_TRANSCRIPT_FORMAT_COUNT) - 1)) | 1u << TCB_TRANSCRIPT_TXT;
+
+    printf("Transcribing file: %s\n", filePath);
+    ma_uint64 start = tcb_time_ns();
+    char outputPath[512];
+    struct whisper_full_params params = tcb_whisper_params(language);
+    if (threads > 0)
+    {
+        params.n_threads = threads;
+    }
+    if (beam)
+    {
+        params.strategy = WHISPER_SAMPLING_BEAM_SEARCH;
+        params.beam_search.beam_size = WHISPER_BEAM_SIZE;
+    }
+    bool cached = cache && tcb_transcribe_cached(params, formats, filePath, outputPath, sizeof(outputPath), tcb_serve_send_segment, &client) == MA_SUCCESS;
+    if (!cached && tcb_transcribe_file(ctx, NULL, params, 1, cache, formats, filePath, outputPath, sizeof(outputPath), tcb_serve_send_segment, &client) != MA_SUCCESS)
+    {
+        dprintf(client, "ERROR failed to transcribe %s\n", filePath);
+        return;
+    }
+
+    printf("Transcription saved to: %s (%.1f s)\n", outputPath, (double)(tcb_time_ns() - start) / 1e9);
+    dprintf(client, "OK %s\n", outputPath);
+}
+
+int tcb_serve(const char *pSocketPath, bool use_gpu)
+{
+    struct sockaddr_un address;
+    if (tcb_socket_address(pSocketPath, &address) != 0)
+    {
+        return -1;
+    }
+
+    printf("Loading model...\n");
+    struct whisper_context *ctx = tcb_whisper_init(use_gpu);
+    if (!ctx)
+    {
+        return -1;
+    }
+
+    int server = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server < 0)
+    {
+        perror("Failed to create socket");
+        whisper_free(ctx);
+        return -1;
+    }
+
+    /* A socket left behind by a killed server would make bind fail. */
+    unlink(pSocketPath);
+    if (bind(server, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(server, 16) != 0)
+    {
+        perror("Failed to listen on socket");
+        close(server);
+        whisper_free(ctx);
+        return -1;
+    }
+    chmod(pSocketPath, 0600);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = tcb_serve_on_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("Listening on: %s\n", pSocketPath);
+    while (!g_serveStop)
+    {
+        int client = accept4(server, NULL, NULL, SOCK_CLOEXEC);
+        if (client < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("Failed to accept connection");
+            break;
+        }
+
+        tcb_serve_job(ctx, client);
+        close(client);
+    }
+
+    printf("Shutting down.\n");
+    close(server);
+    unlink(pSocketPath);
+    whisper_free(ctx);
+    return 0;
+}
+
+int tcb_transcribe_remote(const char *pSocketPath, const char *pFilePath, const char *language, ma_uint32 formats, bool beam, bool cache, int threads)
+{
+    struct sockaddr_un address;
+    if (tcb_socket_address(pSocketPath, &address) != 0)
+    {
+        return -1;
+    }
+
+    /* The server resolves paths from its own working directory. */
+    char filePath[PATH_MAX];
+    if (realpath(pFilePath, filePath) == NULL)
+    {
+        fprintf(stderr, "File not found: %s\n", pFilePath);
+        return -1;
+    }
+
+    int server = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server < 0 || connect(server, (struct sockaddr *)&address, sizeof(address)) != 0)
+    {
+        fprintf(stderr, "Failed to connect to %s, is `tcb serve` running?\n", pSocketPath);
+        if (server >= 0)
+        {
+            close(server);
+        }
+        return -1;
+    }
+
+    printf("Transcribing file: %s\n", filePath);
+    dprintf(server, "TRANSCRIBE %s %u %d %d %d %s\n", language, formats, beam, cache, threads, filePath);
+
+    int status = -1;
+    char response[4096];
+    while (tcb_read_line(server, response, sizeof(response)) >= 0)
+    {
+        if (strncmp(response, "SEGMENT ", 8) == 0)
+        {
+            printf("%s\n", response + 8);
+        }
+        else if (strncmp(response, "OK ", 3) == 0)
+        {
+            printf("Transcription saved to: %s\n", response + 3);
+            status = 0;
+            break;
+        }
+        else if (strncmp(response, "ERROR ", 6) == 0)
+        {
+            fprintf(stderr, "Server error: %s\n", response + 6);
+            break;
+        }
+    }
+
+    close(server);
+    return status;
+}
@@ -0,0 +1,152 @@
+#define _GNU_SOURCE
+#include "tcb.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+
+static double tcb_frames_to_ms(ma_uint64 frames, ma_uint32 sampleRate)
+{
+    return sampleRate > 0 ? (double)frames * 1000.0 / sampleRate : 0.0;
+}
+
+void tcb_stats_print(tcb_context *context, FILE *file)
+{
+    char elapsed[32];
+    tcb_format_timestamp(elapsed, sizeof(elapsed), (ma_int64)((tcb_time_ns() - context->startNs) / 1000000));
+
+    for (ma_uint32 i = 0; i < context->deviceCount; i++)
+    {
+        tcb_device *device = &context->devices[i];
+        tcb_device_stats *stats = &device->stats;
+        ma_uint64 callbacks = atomic_load_explicit(&stats->callbacks, memory_order_relaxed);
+        ma_uint64 jitterTotalNs = atomic_load_explicit(&stats->jitterTotalNs, memory_order_relaxed);
+
+        fprintf(file, "[stats %s] dev%u captured %llu dropped %llu fill max %.1f%% jitter avg %.2f ms max %.2f ms lag max %.1f ms underrun %llu drift %+.1f ppm\n",
+                elapsed,
+                i,
+                (unsigned long long)atomic_load_explicit(&stats->framesCaptured, memory_order_relaxed),
+                (unsigned long long)atomic_load_explicit(&stats->framesDropped, memory_order_relaxed),
+                100.0 * atomic_load_explicit(&stats->fillHighWater, memory_order_relaxed) / device->ringFrames,
+                callbacks > 1 ? (double)jitterTotalNs / (callbacks - 1) / 1e6 : 0.0,
+                (double)atomic_load_explicit(&stats->jitterMaxNs, memory_order_relaxed) / 1e6,
+                tcb_frames_to_ms(atomic_load_explicit(&stats->mixerLagMaxFrames, memory_order_relaxed), device->device.sampleRate),
+                (unsigned long long)atomic_load_explicit(&stats->underrunFrames, memory_order_relaxed),
+                atomic_load_explicit(&stats->driftPpm, memory_order_relaxed));
+    }
+    fflush(file);
+}
+
+static void tcb_report_error_flags(ma_uint32 errors, const char *pSource)
+{
+    static const struct
+    {
+        tcb_error_flag flag;
+        const char *message;
+    } messages[] = {
+        {TCB_ERROR_RING_ACQUIRE, "Failed to acquire write buffer"},
+        {TCB_ERROR_RING_COMMIT, "Failed to commit write buffer"},
+        {TCB_ERROR_MIXER_WAKE, "Failed to wake mixer thread"},
+        {TCB_ERROR_WRITER_WAKE, "Failed to wake writer thread"},
+        {TCB_ERROR_STREAM_PUSH, "Failed to push frames to transcription stream"},
+        {TCB_ERROR_STREAM_OVERFLOW, "Transcription feed fell behind and dropped frames"},
+        {TCB_ERROR_STREAM_WAKE, "Failed to wake transcription feed thread"},
+        {TCB_ERROR_CONVERT, "Failed to convert buffer"},
+    };
+
+    for (size_t i = 0; i < sizeof(messages) / sizeof(messages[0]); i++)
+    {
+        if (errors & messages[i].flag)
+        {
+            fprintf(stderr, "%s (%s).\n", messages[i].message, pSource);
+        }
+    }
+}
+
+/* Prints what the callbacks and the mixer flagged since the last call, once per kind. */
+void tcb_context_report_errors(tcb_context *context)
+{
+    for (ma_uint32 i = 0; i < context->deviceCount; i++)
+    {
+        char source[32];
+        snprintf(source, sizeof(source), "dev%u", i);
+        tcb_report_error_flags(atomic_exchange(&context->devices[i].stats.errors, 0), source);
+    }
+    tcb_report_error_flags(atomic_exchange(&context->errors, 0), "mixer");
+}
+
+void *tcb_stats_thread(void *arg)
+{
+    tcb_context *context = (tcb_context *)arg;
+
+    /* Sleeps on its own descriptor so stopping does not wait out the interval. */
+    struct pollfd pfd = {.fd = context->statsFd, .events = POLLIN};
+    while (atomic_load(&context->running))
+    {
+        if (poll(&pfd, 1, (int)context->statsIntervalMs) != 0)
+        {
+            break;
+        }
+
+        tcb_stats_print(context, stderr);
+        tcb_context_report_errors(context);
+    }
+
+    return NULL;
+}
+
+ma_result tcb_stats_write_json(tcb_context *context, const char *pFilePath)
+{
+    FILE *file = fopen(pFilePath, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open stats file: %s\n", pFilePath);
+        return MA_ERROR;
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"duration_ms\": %llu,\n", (unsigned long long)((tcb_time_ns() - context->startNs) / 1000000));
+    fprintf(file, "  \"mixer\": {\n");
+    fprintf(file, "    \"kernel\": \"%s\",\n", context->mixKernel->name);
+    fprintf(file, "    \"wakeups\": %llu,\n", (unsigned long long)context->wakeups);
+    fprintf(file, "    \"latency_avg_ms\": %.3f,\n", context->mixLatencyCount > 0 ? (double)context->mixLatencyTotalNs / context->mixLatencyCount / 1e6 : 0.0);
+    fprintf(file, "    \"latency_max_ms\": %.3f,\n", (double)context->mixLatencyMaxNs / 1e6);
+    fprintf(file, "    \"heap_calls\": %llu\n", (unsigned long long)tcb_context_heap_calls(context));
+    fprintf(file, "  },\n");
+    fprintf(file, "  \"devices\": [\n");
+    for (ma_uint32 i = 0; i < context->deviceCount; i++)
+    {
+        tcb_device *device = &context->devices[i];
+        tcb_device_stats *stats = &device->stats;
+        ma_uint32 sampleRate = device->device.sampleRate;
+        ma_uint64 callbacks = atomic_load(&stats->callbacks);
+        ma_uint32 fillHighWater = atomic_load(&stats->fillHighWater);
+
+        fprintf(file, "    {\n");
+        fprintf(file, "      \"index\": %u,\n", i);
+        fprintf(file, "      \"sample_rate\": %u,\n", sampleRate);
+        fprintf(file, "      \"channels\": %u,\n", device->device.capture.channels);
+        fprintf(file, "      \"period_frames\": %u,\n", device->device.capture.internalPeriodSizeInFrames);
+        fprintf(file, "      \"periods\": %u,\n", device->device.capture.internalPeriods);
+        fprintf(file, "      \"ring_frames\": %u,\n", device->ringFrames);
+        fprintf(file, "      \"ring_ms\": %.1f,\n", tcb_frames_to_ms(device->ringFrames, sampleRate));
+        fprintf(file, "      \"frames_captured\": %llu,\n", (unsigned long long)atomic_load(&stats->framesCaptured));
+        fprintf(file, "      \"frames_dropped\": %llu,\n", (unsigned long long)atomic_load(&stats->framesDropped));
+        fprintf(file, "      \"fill_high_water_frames\": %u,\n", fillHighWater);
+        fprintf(file, "      \"fill_high_water_ms\": %.1f,\n", tcb_frames_to_ms(fillHighWater, sampleRate));
+        fprintf(file, "      \"callbacks\": %llu,\n", (unsigned long long)callbacks);
+        fprintf(file, "      \"jitter_avg_ms\": %.3f,\n", callbacks > 1 ? (double)atomic_load(&stats->jitterTotalNs) / (callbacks - 1) / 1e6 : 0.0);
+        fprintf(file, "      \"jitter_max_ms\": %.3f,\n", (double)atomic_load(&stats->jitterMaxNs) / 1e6);
+        fprintf(file, "      \"mixer_lag_max_ms\": %.1f,\n", tcb_frames_to_ms(atomic_load(&stats->mixerLagMaxFrames), sampleRate));
+        fprintf(file, "      \"underrun_frames\": %llu,\n", (unsigned long long)atomic_load(&stats->underrunFrames));
+        fprintf(file, "      \"drift_ppm\": %.2f\n", atomic_load(&stats->driftPpm));
+        fprintf(file, "    }%s\n", i + 1 < context->deviceCount ? "," : "");
+    }
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+
+    fclose(file);
+    return MA_SUCCESS;
+}
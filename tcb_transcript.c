@@ -0,0 +1,320 @@
+#define _GNU_SOURCE
+#include "tcb.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <limits.h>
+#include <unistd.h>
+
+static const char *g_transcriptExtensions[TCB_TRANSCRIPT_FORMAT_COUNT] = {"txt", "srt", "vtt", "jsonl"};
+static const char *g_transcriptFormatNames[TCB_TRANSCRIPT_FORMAT_COUNT] = {"txt", "srt", "vtt", "json"};
+
+/* Comma separated names, e.g. "srt,json". The plain text transcript is always written. */
+ma_result tcb_transcript_format_parse(const char *pList, ma_uint32 *pFormats)
+{
+    *pFormats = 1u << TCB_TRANSCRIPT_TXT;
+    while (*pList != '\0')
+    {
+        size_t length = strcspn(pList, ",");
+        int format = -1;
+        for (int i = 0; i < TCB_TRANSCRIPT_FORMAT_COUNT; i++)
+        {
+            if (strlen(g_transcriptFormatNames[i]) == length && strncmp(pList, g_transcriptFormatNames[i], length) == 0)
+            {
+                format = i;
+            }
+        }
+
+        if (format < 0)
+        {
+            fprintf(stderr, "Unknown transcript format: %.*s\n", (int)length, pList);
+            return MA_INVALID_ARGS;
+        }
+        *pFormats |= 1u << format;
+        pList += length + (pList[length] == ',' ? 1 : 0);
+    }
+
+    return MA_SUCCESS;
+}
+
+static void tcb_transcript_writer_header(tcb_transcript_writer *writer)
+{
+    if (writer->files[TCB_TRANSCRIPT_VTT] != NULL)
+    {
+        fprintf(writer->files[TCB_TRANSCRIPT_VTT], "WEBVTT\n\n");
+    }
+}
+
+/* Every format is written next to the text transcript, e.g. rec.txt, rec.srt, rec.vtt and rec.jsonl. */
+ma_result tcb_transcript_writer_open(tcb_transcript_writer *writer, const char *pTextPath, ma_uint32 formats, bool timestamps)
+{
+    memset(writer, 0, sizeof(*writer));
+    writer->formats = formats | (1u << TCB_TRANSCRIPT_TXT);
+    writer->timestamps = timestamps;
+
+    const char *dot = strrchr(pTextPath, '.');
+    int baseLength = (int)(dot != NULL ? dot - pTextPath : (ptrdiff_t)strlen(pTextPath));
+    for (int i = 0; i < TCB_TRANSCRIPT_FORMAT_COUNT; i++)
+    {
+        if ((writer->formats & (1u << i)) == 0)
+        {
+            continue;
+        }
+
+        char path[PATH_MAX];
+        if (i == TCB_TRANSCRIPT_TXT)
+        {
+            snprintf(path, sizeof(path), "%s", pTextPath);
+        }
+        else
+        {
+            snprintf(path, sizeof(path), "%.*s.%s", baseLength, pTextPath, g_transcriptExtensions[i]);
+        }
+
+        writer->files[i] = fopen(path, "w");
+        if (writer->files[i] == NULL)
+        {
+            fprintf(stderr, "Failed to open transcription file: %s\n", path);
+            tcb_transcript_writer_close(writer);
+            return MA_ERROR;
+        }
+    }
+
+    tcb_transcript_writer_header(writer);
+    return MA_SUCCESS;
+}
+
+/* SRT separates milliseconds with a comma, everything else with a dot. */
+static void tcb_transcript_cue_time(char *buffer, size_t bufferSize, ma_int64 ms, char separator)
+{
+    tcb_format_timestamp(buffer, bufferSize, ms);
+    char *dot = strrchr(buffer, '.');
+    if (dot != NULL)
+    {
+        *dot = separator;
+    }
+}
+
+/* Length of the well-formed UTF-8 sequence at c, 0 if there is none: overlong, surrogate, past U+10FFFF or cut short. */
+static size_t tcb_transcript_utf8_length(const unsigned char *c)
+{
+    if (c[0] < 0x80)
+    {
+        return 1;
+    }
+
+    size_t length;
+    unsigned char min = 0x80;
+    unsigned char max = 0xBF;
+    if (c[0] >= 0xC2 && c[0] <= 0xDF)
+    {
+        length = 2;
+    }
+    else if (c[0] >= 0xE0 && c[0] <= 0xEF)
+    {
+        length = 3;
+        min = c[0] == 0xE0 ? 0xA0 : 0x80;
+        max = c[0] == 0xED ? 0x9F : 0xBF;
+    }
+    else if (c[0] >= 0xF0 && c[0] <= 0xF4)
+    {
+        length = 4;
+        min = c[0] == 0xF0 ? 0x90 : 0x80;
+        max = c[0] == 0xF4 ? 0x8F : 0xBF;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (c[1] < min || c[1] > max)
+    {
+        return 0;
+    }
+    for (size_t i = 2; i < length; i++)
+    {
+        if ((c[i] & 0xC0) != 0x80)
+        {
+            return 0;
+        }
+    }
+
+    return length;
+}
+
+/*
+ * Whisper's tokens are BPE pieces that can end or start inside a UTF-8
+ * character, so bytes that do not form one are written as U+FFFD and the
+ * output stays valid JSON. Returns false if any were replaced.
+ */
+static bool tcb_transcript_json_string(FILE *file, const char *text)
+{
+    bool valid = true;
+    fputc('"', file);
+    for (const unsigned char *c = (const unsigned char *)text; *c != '\0';)
+    {
+        size_t length = tcb_transcript_utf8_length(c);
+        if (length == 0)
+        {
+            fputs("\\ufffd", file);
+            valid = false;
+            c++;
+            continue;
+        }
+
+        if (*c == '"' || *c == '\\')
+        {
+            fprintf(file, "\\%c", *c);
+        }
+        else if (*c < 0x20)
+        {
+            fprintf(file, "\\u%04x", *c);
+        }
+        else
+        {
+            fwrite(c, 1, length, file);
+        }
+        c += length;
+    }
+    fputc('"', file);
+
+    return valid;
+}
+
+static void tcb_transcript_write_json(tcb_transcript_writer *writer, const tcb_cache_entry *entry, size_t segment, bool refined)
+{
+    FILE *file = writer->files[TCB_TRANSCRIPT_JSON];
+    const tcb_cache_segment *cue = &entry->segments[segment];
+    fprintf(file, "{\"index\":%zu,%s\"t0\":%.3f,\"t1\":%.3f,\"text\":", segment, refined ? "\"refined\":true," : "", cue->t0Ms / 1000.0, cue->t1Ms / 1000.0);
+    tcb_transcript_json_string(file, tcb_cache_entry_text(entry, segment));
+    fprintf(file, ",\"logprob\":%.4f,\"tokens\":[", cue->logprob);
+    for (size_t i = cue->tokenOffset; i < cue->tokenOffset + cue->tokenCount; i++)
+    {
+        const char *text = tcb_cache_entry_token_text(entry, i);
+        fprintf(file, "%s{\"id\":%d,\"text\":", i > cue->tokenOffset ? "," : "", (int)entry->tokens[i].id);
+        if (!tcb_transcript_json_string(file, text))
+        {
+            /* A token holding part of a character also gets its raw bytes, so consecutive tokens can be joined. */
+            fprintf(file, ",\"bytes\":\"");
+            for (const unsigned char *c = (const unsigned char *)text; *c != '\0'; c++)
+            {
+                fprintf(file, "%02x", *c);
+            }
+            fputc('"', file);
+        }
+        fprintf(file, ",\"p\":%.4f}", entry->tokens[i].p);
+    }
+    fprintf(file, "]}\n");
+}
+
+/* The text, SRT and VTT forms of one segment, numbered from 1 in SRT. */
+static void tcb_transcript_write_text(tcb_transcript_writer *writer, const tcb_cache_entry *entry, size_t segment)
+{
+    const tcb_cache_segment *cue = &entry->segments[segment];
+    const char *text = tcb_cache_entry_text(entry, segment);
+    const char *cueText = text + strspn(text, " ");
+    char start[32], end[32];
+
+    FILE *file = writer->files[TCB_TRANSCRIPT_TXT];
+    if (writer->timestamps)
+    {
+        tcb_format_timestamp(start, sizeof(start), cue->t0Ms);
+        tcb_format_timestamp(end, sizeof(end), cue->t1Ms);
+        fprintf(file, "[%s --> %s] %s\n", start, end, text);
+    }
+    else
+    {
+        fprintf(file, "%s\n", text);
+    }
+
+    if ((file = writer->files[TCB_TRANSCRIPT_SRT]) != NULL)
+    {
+        tcb_transcript_cue_time(start, sizeof(start), cue->t0Ms, ',');
+        tcb_transcript_cue_time(end, sizeof(end), cue->t1Ms, ',');
+        fprintf(file, "%zu\n%s --> %s\n%s\n\n", segment + 1, start, end, cueText);
+    }
+
+    if ((file = writer->files[TCB_TRANSCRIPT_VTT]) != NULL)
+    {
+        tcb_format_timestamp(start, sizeof(start), cue->t0Ms);
+        tcb_format_timestamp(end, sizeof(end), cue->t1Ms);
+        fprintf(file, "%s --> %s\n%s\n\n", start, end, cueText);
+    }
+}
+
+void tcb_transcript_writer_segment(tcb_transcript_writer *writer, const tcb_cache_entry *entry, size_t segment)
+{
+    tcb_transcript_write_text(writer, entry, segment);
+    if (writer->files[TCB_TRANSCRIPT_JSON] != NULL)
+    {
+        tcb_transcript_write_json(writer, entry, segment, false);
+    }
+}
+
+/* JSON lines are only ever appended: a refined segment gets a second line with the same index. */
+void tcb_transcript_writer_refined(tcb_transcript_writer *writer, const tcb_cache_entry *entry, size_t segment)
+{
+    if (writer->files[TCB_TRANSCRIPT_JSON] != NULL)
+    {
+        tcb_transcript_write_json(writer, entry, segment, true);
+    }
+}
+
+/* Writes the text, SRT and VTT files again from entry, after segments were replaced. */
+ma_result tcb_transcript_writer_rewrite(tcb_transcript_writer *writer, const tcb_cache_entry *entry)
+{
+    for (int i = 0; i < TCB_TRANSCRIPT_FORMAT_COUNT; i++)
+    {
+        if (writer->files[i] != NULL && i != TCB_TRANSCRIPT_JSON)
+        {
+            rewind(writer->files[i]);
+        }
+    }
+
+    tcb_transcript_writer_header(writer);
+    for (size_t i = 0; i < entry->segmentCount; i++)
+    {
+        tcb_transcript_write_text(writer, entry, i);
+    }
+
+    ma_result result = MA_SUCCESS;
+    for (int i = 0; i < TCB_TRANSCRIPT_FORMAT_COUNT; i++)
+    {
+        FILE *file = writer->files[i];
+        if (file != NULL && i != TCB_TRANSCRIPT_JSON &&
+            (fflush(file) != 0 || ftruncate(fileno(file), ftell(file)) != 0))
+        {
+            result = MA_ERROR;
+        }
+    }
+
+    return result;
+}
+
+void tcb_transcript_writer_flush(tcb_transcript_writer *writer)
+{
+    for (int i = 0; i < TCB_TRANSCRIPT_FORMAT_COUNT; i++)
+    {
+        if (writer->files[i] != NULL)
+        {
+            fflush(writer->files[i]);
+        }
+    }
+}
+
+ma_result tcb_transcript_writer_close(tcb_transcript_writer *writer)
+{
+    ma_result result = MA_SUCCESS;
+    for (int i = 0; i < TCB_TRANSCRIPT_FORMAT_COUNT; i++)
+    {
+        if (writer->files[i] != NULL && fclose(writer->files[i]) != 0)
+        {
+            result = MA_ERROR;
+        }
+        writer->files[i] = NULL;
+    }
+
+    return result;
+}
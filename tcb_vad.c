@@ -0,0 +1,129 @@
+#include "tcb.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define VAD_FRAME_SAMPLES (TARGET_SAMPLE_RATE * VAD_FRAME_MS / 1000)
+
+static int tcb_vad_compare(const void *a, const void *b)
+{
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+ma_result tcb_vad_init(tcb_vad *vad, ma_uint64 maxFrames)
+{
+    memset(vad, 0, sizeof(*vad));
+    vad->blockCapacity = (maxFrames + VAD_FRAME_SAMPLES - 1) / VAD_FRAME_SAMPLES;
+    vad->energies = malloc(vad->blockCapacity * sizeof(float));
+    vad->sorted = malloc(vad->blockCapacity * sizeof(float));
+    vad->spans = malloc((vad->blockCapacity / 2 + 1) * sizeof(tcb_vad_span));
+    if (!vad->energies || !vad->sorted || !vad->spans)
+    {
+        tcb_vad_uninit(vad);
+        return MA_OUT_OF_MEMORY;
+    }
+
+    return MA_SUCCESS;
+}
+
+void tcb_vad_uninit(tcb_vad *vad)
+{
+    free(vad->energies);
+    free(vad->sorted);
+    free(vad->spans);
+    vad->energies = NULL;
+    vad->sorted = NULL;
+    vad->spans = NULL;
+}
+
+ma_uint64 tcb_vad_detect(tcb_vad *vad, const ma_float *samples, ma_uint64 frameCount)
+{
+    ma_uint64 blockCount = ma_min((frameCount + VAD_FRAME_SAMPLES - 1) / VAD_FRAME_SAMPLES, vad->blockCapacity);
+    for (ma_uint64 b = 0; b < blockCount; b++)
+    {
+        ma_uint64 start = b * VAD_FRAME_SAMPLES;
+        ma_uint64 end = ma_min(start + VAD_FRAME_SAMPLES, frameCount);
+        double sum = 0.0;
+        for (ma_uint64 i = start; i < end; i++)
+        {
+            sum += (double)samples[i] * samples[i];
+        }
+        vad->energies[b] = (float)(10.0 * log10(sum / (end - start) + 1e-12));
+    }
+
+    /* The quietest blocks of the window tell us what silence sounds like here. */
+    memcpy(vad->sorted, vad->energies, blockCount * sizeof(float));
+    qsort(vad->sorted, blockCount, sizeof(float), tcb_vad_compare);
+    float threshold = ma_max(vad->sorted[blockCount * VAD_FLOOR_PERCENTILE / 100] + VAD_MARGIN_DB, VAD_MIN_DB);
+
+    const ma_uint64 pad = (ma_uint64)TARGET_SAMPLE_RATE * VAD_PAD_MS / 1000;
+    const ma_uint64 minSilence = (ma_uint64)TARGET_SAMPLE_RATE * VAD_MIN_SILENCE_MS / 1000;
+    vad->spanCount = 0;
+    for (ma_uint64 b = 0; b < blockCount; b++)
+    {
+        if (vad->energies[b] < threshold)
+        {
+            continue;
+        }
+
+        ma_uint64 start = b * VAD_FRAME_SAMPLES;
+        start = start > pad ? start - pad : 0;
+        ma_uint64 end = ma_min((b + 1) * VAD_FRAME_SAMPLES + pad, frameCount);
+
+        tcb_vad_span *last = vad->spanCount > 0 ? &vad->spans[vad->spanCount - 1] : NULL;
+        if (last != NULL && start <= last->start + last->length + minSilence)
+        {
+            last->length = end - last->start;
+        }
+        else
+        {
+            vad->spans[vad->spanCount].start = start;
+            vad->spans[vad->spanCount].length = end - start;
+            vad->spanCount++;
+        }
+    }
+
+    ma_uint64 packed = 0;
+    for (ma_uint32 i = 0; i < vad->spanCount; i++)
+    {
+        vad->spans[i].packedStart = packed;
+        packed += vad->spans[i].length;
+    }
+
+    return packed;
+}
+
+void tcb_vad_pack(const tcb_vad *vad, const ma_float *samples, ma_float *pPacked)
+{
+    /* Spans are ordered and never overlap, so packing forward is also safe in place. */
+    for (ma_uint32 i = 0; i < vad->spanCount; i++)
+    {
+        const tcb_vad_span *span = &vad->spans[i];
+        if (samples + span->start != pPacked + span->packedStart)
+        {
+            memmove(pPacked + span->packedStart, samples + span->start, span->length * sizeof(ma_float));
+        }
+    }
+}
+
+ma_int64 tcb_vad_map_ms(const tcb_vad *vad, ma_int64 packedMs)
+{
+    if (vad->spanCount == 0)
+    {
+        return packedMs;
+    }
+
+    ma_uint64 frame = packedMs > 0 ? (ma_uint64)packedMs * TARGET_SAMPLE_RATE / 1000 : 0;
+    ma_uint32 i = 0;
+    while (i + 1 < vad->spanCount && frame >= vad->spans[i + 1].packedStart)
+    {
+        i++;
+    }
+
+    const tcb_vad_span *span = &vad->spans[i];
+    ma_uint64 offset = ma_min(frame - span->packedStart, span->length);
+    return (ma_int64)((span->start + offset) * 1000 / TARGET_SAMPLE_RATE);
+}
@@ -0,0 +1,456 @@
+#define _GNU_SOURCE
+#include "tcb.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sndfile.h>
+
+const char *tcb_output_format_extension(tcb_output_format format)
+{
+    switch (format)
+    {
+    case TCB_FORMAT_FLAC:
+        return "flac";
+    case TCB_FORMAT_OPUS:
+        return "opus";
+    default:
+        return "wav";
+    }
+}
+
+static int tcb_output_format_sndfile(tcb_output_format format)
+{
+    switch (format)
+    {
+    case TCB_FORMAT_FLAC:
+        return SF_FORMAT_FLAC | SF_FORMAT_PCM_16;
+    case TCB_FORMAT_OPUS:
+        return SF_FORMAT_OGG | SF_FORMAT_OPUS;
+    default:
+        return SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+    }
+}
+
+ma_result tcb_track_path(const char *pFilePath, int track, char *pOutputPath, size_t outputPathSize)
+{
+    const char *dot = strrchr(pFilePath, '.');
+    const char *extension = dot != NULL ? dot : "";
+    int baseLength = dot != NULL ? (int)(dot - pFilePath) : (int)strlen(pFilePath);
+
+    int length = track < 0 ? snprintf(pOutputPath, outputPathSize, "%.*s.tracks%s", baseLength, pFilePath, extension)
+                           : snprintf(pOutputPath, outputPathSize, "%.*s.track%d%s", baseLength, pFilePath, track, extension);
+    if (length < 0 || (size_t)length >= outputPathSize)
+    {
+        fprintf(stderr, "Error: track path is too long\n");
+        return MA_INVALID_ARGS;
+    }
+
+    return MA_SUCCESS;
+}
+
+ma_result tcb_segment_path(const char *pFilePath, ma_uint32 segment, char *pOutputPath, size_t outputPathSize)
+{
+    const char *dot = strrchr(pFilePath, '.');
+    const char *extension = dot != NULL ? dot : "";
+    int baseLength = dot != NULL ? (int)(dot - pFilePath) : (int)strlen(pFilePath);
+
+    int length = snprintf(pOutputPath, outputPathSize, "%.*s.part%03u%s", baseLength, pFilePath, segment, extension);
+    if (length < 0 || (size_t)length >= outputPathSize)
+    {
+        fprintf(stderr, "Error: segment path is too long\n");
+        return MA_INVALID_ARGS;
+    }
+
+    return MA_SUCCESS;
+}
+
+tcb_writer_config tcb_writer_config_init(const char *pFilePath, ma_uint32 sourceCount)
+{
+    tcb_writer_config config;
+    config.pFilePath = pFilePath;
+    config.format = TCB_FORMAT_WAV;
+    config.trackMode = TCB_TRACKS_NONE;
+    config.sourceCount = sourceCount;
+    config.segmentMs = 0;
+    config.checkpointMs = WRITER_CHECKPOINT_MS;
+    config.onFileClosed = NULL;
+    config.pUserData = NULL;
+    config.pAllocationCallbacks = NULL;
+
+    return config;
+}
+
+static ma_result tcb_writer_track_open(tcb_writer *writer, ma_uint32 index)
+{
+    tcb_writer_track *track = &writer->tracks[index];
+
+    /* Segments number the recording first, tracks then split each segment. */
+    char basePath[512];
+    ma_result result = MA_SUCCESS;
+    if (writer->segmentFrames > 0)
+    {
+        result = tcb_segment_path(writer->filePath, track->segment, basePath, sizeof(basePath));
+    }
+    else
+    {
+        snprintf(basePath, sizeof(basePath), "%s", writer->filePath);
+    }
+
+    if (result == MA_SUCCESS && index > 0)
+    {
+        result = tcb_track_path(basePath, writer->trackMode == TCB_TRACKS_MULTICHANNEL ? -1 : (int)index - 1, track->path, sizeof(track->path));
+    }
+    else if (result == MA_SUCCESS)
+    {
+        snprintf(track->path, sizeof(track->path), "%s", basePath);
+    }
+
+    if (result != MA_SUCCESS)
+    {
+        return result;
+    }
+
+    SF_INFO info;
+    memset(&info, 0, sizeof(info));
+    info.samplerate = TARGET_SAMPLE_RATE;
+    info.channels = (int)track->channels;
+    info.format = tcb_output_format_sndfile(writer->format);
+
+    track->file = sf_open(track->path, SFM_WRITE, &info);
+    if (track->file == NULL)
+    {
+        fprintf(stderr, "Failed to initialize output file: %s (%s)\n", track->path, sf_strerror(NULL));
+        return MA_ERROR;
+    }
+
+    /* Unmixed tracks can overshoot after resampling, clip instead of wrapping in integer formats. */
+    sf_command(track->file, SFC_SET_CLIPPING, NULL, SF_TRUE);
+    track->segmentFramesWritten = 0;
+
+    return MA_SUCCESS;
+}
+
+static void tcb_writer_track_close(tcb_writer *writer, ma_uint32 index)
+{
+    tcb_writer_track *track = &writer->tracks[index];
+    if (track->file == NULL)
+    {
+        return;
+    }
+
+    sf_close(track->file);
+    track->file = NULL;
+    track->segment++;
+    if (writer->onFileClosed != NULL)
+    {
+        writer->onFileClosed(writer->pUserData, index, track->path);
+    }
+}
+
+ma_result tcb_writer_init(tcb_writer *writer, const tcb_writer_config *config)
+{
+    memset(writer, 0, sizeof(*writer));
+    snprintf(writer->filePath, sizeof(writer->filePath), "%s", config->pFilePath);
+    writer->format = config->format;
+    writer->trackMode = config->trackMode;
+    writer->segmentFrames = (ma_uint64)TARGET_SAMPLE_RATE * config->segmentMs / 1000;
+    writer->checkpointMs = config->checkpointMs;
+    writer->wakeFd = -1;
+    atomic_init(&writer->running, false);
+
+    tcb_track_mode trackMode = config->trackMode;
+    ma_uint32 sourceCount = config->sourceCount;
+
+    /* Track 0 is always the mix, tracks follow as one multichannel file or one file each. */
+    ma_uint32 trackCount = 1;
+    if (trackMode == TCB_TRACKS_MULTICHANNEL)
+    {
+        trackCount = 2;
+    }
+    else if (trackMode == TCB_TRACKS_SEPARATE)
+    {
+        trackCount = 1 + sourceCount;
+    }
+
+    writer->tracks = calloc(trackCount, sizeof(tcb_writer_track));
+    writer->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (writer->tracks == NULL || writer->wakeFd < 0)
+    {
+        fprintf(stderr, "Failed to initialize writer.\n");
+        tcb_writer_uninit(writer);
+        return MA_ERROR;
+    }
+    writer->trackCount = trackCount;
+
+    ma_uint32 ringFrames = (ma_uint32)((ma_uint64)TARGET_SAMPLE_RATE * WRITER_RING_MS / 1000);
+    for (ma_uint32 i = 0; i < trackCount; i++)
+    {
+        tcb_writer_track *track = &writer->tracks[i];
+        track->channels = trackMode == TCB_TRACKS_MULTICHANNEL && i == 1 ? sourceCount : TARGET_CHANNELS;
+
+        ma_result result = ma_pcm_rb_init(TARGET_FORMAT, track->channels, ringFrames, NULL, config->pAllocationCallbacks, &track->rb);
+        if (result != MA_SUCCESS)
+        {
+            fprintf(stderr, "Failed to initialize writer ring buffer.\n");
+            tcb_writer_uninit(writer);
+            return result;
+        }
+        track->rbReady = true;
+
+        result = tcb_writer_track_open(writer, i);
+        if (result != MA_SUCCESS)
+        {
+            tcb_writer_uninit(writer);
+            return result;
+        }
+    }
+
+    /* Set last so files abandoned by a failed init are never reported. */
+    writer->onFileClosed = config->onFileClosed;
+    writer->pUserData = config->pUserData;
+
+    return MA_SUCCESS;
+}
+
+ma_result tcb_writer_start(tcb_writer *writer)
+{
+    writer->lastCheckpointNs = tcb_time_ns();
+    atomic_store(&writer->running, true);
+    if (pthread_create(&writer->thread, NULL, tcb_writer_thread, writer) != 0)
+    {
+        fprintf(stderr, "Failed to start writer thread.\n");
+        atomic_store(&writer->running, false);
+        return MA_ERROR;
+    }
+    writer->started = true;
+
+    return MA_SUCCESS;
+}
+
+/*
+ * Copies frameCount frames into the track's ring, interleaving sourceCount
+ * planar buffers on the way. Whatever does not fit is counted and dropped,
+ * the mixer never waits for the disk.
+ */
+static void tcb_writer_track_write(tcb_writer_track *track, const ma_float *const *ppSources, ma_uint32 sourceCount, ma_uint64 frameCount)
+{
+    ma_uint64 framesWritten = 0;
+    while (framesWritten < frameCount)
+    {
+        ma_uint32 framesToWrite = (ma_uint32)ma_min(frameCount - framesWritten, 0xFFFFFFFF);
+        void *rbWrite;
+        if (ma_pcm_rb_acquire_write(&track->rb, &framesToWrite, &rbWrite) != MA_SUCCESS || framesToWrite == 0)
+        {
+            break;
+        }
+
+        ma_float *out = (ma_float *)rbWrite;
+        if (sourceCount == 1)
+        {
+            memcpy(out, ppSources[0] + framesWritten, framesToWrite * sizeof(ma_float));
+        }
+        else
+        {
+            for (ma_uint32 i = 0; i < framesToWrite; i++)
+            {
+                for (ma_uint32 s = 0; s < sourceCount; s++)
+                {
+                    out[i * sourceCount + s] = ppSources[s][framesWritten + i];
+                }
+            }
+        }
+
+        ma_pcm_rb_commit_write(&track->rb, framesToWrite);
+        framesWritten += framesToWrite;
+    }
+
+    if (framesWritten < frameCount)
+    {
+        atomic_fetch_add_explicit(&track->droppedFrames, frameCount - framesWritten, memory_order_relaxed);
+    }
+}
+
+void tcb_writer_write_sources(tcb_writer *writer, const ma_float *const *ppSources, ma_uint32 sourceCount, ma_uint64 frameCount)
+{
+    if (writer->trackMode == TCB_TRACKS_MULTICHANNEL)
+    {
+        tcb_writer_track_write(&writer->tracks[1], ppSources, sourceCount, frameCount);
+    }
+    else if (writer->trackMode == TCB_TRACKS_SEPARATE)
+    {
+        for (ma_uint32 s = 0; s < sourceCount && s + 1 < writer->trackCount; s++)
+        {
+            tcb_writer_track_write(&writer->tracks[s + 1], &ppSources[s], 1, frameCount);
+        }
+    }
+}
+
+ma_result tcb_writer_write_mix(tcb_writer *writer, const ma_float *pMix, ma_uint64 frameCount)
+{
+    tcb_writer_track_write(&writer->tracks[0], &pMix, 1, frameCount);
+
+    /* Runs on the mixer thread, so a failure is returned for the caller to flag instead of printed. */
+    ma_uint64 one = 1;
+    return write(writer->wakeFd, &one, sizeof(one)) == sizeof(one) ? MA_SUCCESS : MA_ERROR;
+}
+
+static void tcb_writer_drain(tcb_writer *writer)
+{
+    for (ma_uint32 i = 0; i < writer->trackCount; i++)
+    {
+        tcb_writer_track *track = &writer->tracks[i];
+        ma_uint32 framesAvailable;
+        while ((framesAvailable = ma_pcm_rb_available_read(&track->rb)) > 0)
+        {
+            /* The next segment is only created once there is audio for it. */
+            if (track->file == NULL && tcb_writer_track_open(writer, i) != MA_SUCCESS)
+            {
+                void *rbRead;
+                ma_pcm_rb_acquire_read(&track->rb, &framesAvailable, &rbRead);
+                ma_pcm_rb_commit_read(&track->rb, framesAvailable);
+                atomic_fetch_add_explicit(&track->droppedFrames, framesAvailable, memory_order_relaxed);
+                break;
+            }
+
+            /* Every track rotates after exactly segmentFrames, so segments stay aligned. */
+            if (writer->segmentFrames > 0)
+            {
+                framesAvailable = (ma_uint32)ma_min(framesAvailable, writer->segmentFrames - track->segmentFramesWritten);
+            }
+
+            void *rbRead;
+            if (ma_pcm_rb_acquire_read(&track->rb, &framesAvailable, &rbRead) != MA_SUCCESS)
+            {
+                break;
+            }
+
+            if (sf_writef_float(track->file, (const float *)rbRead, framesAvailable) != (sf_count_t)framesAvailable)
+            {
+                fprintf(stderr, "Failed to write to encoder: %s\n", sf_strerror(track->file));
+            }
+            ma_pcm_rb_commit_read(&track->rb, framesAvailable);
+
+            track->segmentFramesWritten += framesAvailable;
+            if (writer->segmentFrames > 0 && track->segmentFramesWritten >= writer->segmentFrames)
+            {
+                tcb_writer_track_close(writer, i);
+            }
+        }
+    }
+}
+
+/*
+ * Rewrites the headers with the current length and flushes to disk, so a
+ * kill or power loss costs a WAV at most one checkpoint interval of audio.
+ * FLAC and Opus only get what the encoder has already handed to the file
+ * flushed, their headers are final on close only. --segment bounds the
+ * loss for those to the open segment.
+ */
+static void tcb_writer_checkpoint(tcb_writer *writer)
+{
+    for (ma_uint32 i = 0; i < writer->trackCount; i++)
+    {
+        SNDFILE *file = writer->tracks[i].file;
+        if (file != NULL)
+        {
+            sf_command(file, SFC_UPDATE_HEADER_NOW, NULL, 0);
+            sf_write_sync(file);
+        }
+    }
+}
+
+void *tcb_writer_thread(void *arg)
+{
+    tcb_writer *writer = (tcb_writer *)arg;
+
+    struct pollfd pfd = {.fd = writer->wakeFd, .events = POLLIN};
+    while (atomic_load(&writer->running))
+    {
+        if (poll(&pfd, 1, MIXER_WAKE_TIMEOUT_MS) > 0)
+        {
+            ma_uint64 wakeups;
+            if (read(writer->wakeFd, &wakeups, sizeof(wakeups)) != sizeof(wakeups))
+            {
+                continue;
+            }
+        }
+
+        tcb_writer_drain(writer);
+
+        ma_uint64 nowNs = tcb_time_ns();
+        if (writer->checkpointMs > 0 && nowNs - writer->lastCheckpointNs >= (ma_uint64)writer->checkpointMs * 1000000)
+        {
+            tcb_writer_checkpoint(writer);
+            writer->lastCheckpointNs = nowNs;
+        }
+    }
+
+    tcb_writer_drain(writer);
+    return NULL;
+}
+
+void tcb_writer_stop(tcb_writer *writer)
+{
+    if (!writer->started)
+    {
+        return;
+    }
+
+    atomic_store(&writer->running, false);
+    ma_uint64 one = 1;
+    if (write(writer->wakeFd, &one, sizeof(one)) != sizeof(one))
+    {
+        fprintf(stderr, "Failed to wake writer thread.\n");
+    }
+    pthread_join(writer->thread, NULL);
+    writer->started = false;
+}
+
+ma_uint64 tcb_writer_dropped_frames(tcb_writer *writer)
+{
+    ma_uint64 droppedFrames = 0;
+    for (ma_uint32 i = 0; i < writer->trackCount; i++)
+    {
+        droppedFrames += atomic_load(&writer->tracks[i].droppedFrames);
+    }
+
+    return droppedFrames;
+}
+
+ma_uint32 tcb_writer_available_frames(tcb_writer *writer)
+{
+    ma_uint32 availableFrames = 0xFFFFFFFF;
+    for (ma_uint32 i = 0; i < writer->trackCount; i++)
+    {
+        availableFrames = ma_min(availableFrames, ma_pcm_rb_available_write(&writer->tracks[i].rb));
+    }
+
+    return availableFrames;
+}
+
+void tcb_writer_uninit(tcb_writer *writer)
+{
+    tcb_writer_stop(writer);
+    for (ma_uint32 i = 0; writer->tracks != NULL && i < writer->trackCount; i++)
+    {
+        tcb_writer_track *track = &writer->tracks[i];
+        tcb_writer_track_close(writer, i);
+        if (track->rbReady)
+        {
+            ma_pcm_rb_uninit(&track->rb);
+        }
+    }
+    free(writer->tracks);
+    writer->tracks = NULL;
+    writer->trackCount = 0;
+
+    if (writer->wakeFd >= 0)
+    {
+        close(writer->wakeFd);
+        writer->wakeFd = -1;
+    }
+}